@@ -2,6 +2,7 @@
 
 #include "configuration.hh"
 #include "util.hh"
+#include "wavfile.hh"
 #include "libda/fft.hpp"  // For M_PI
 #include "libda/portaudio.hpp"
 #include <boost/ptr_container/ptr_map.hpp>
@@ -136,11 +137,26 @@ public:
 };
 
 class Music {
+	/// A single audio stream, read directly from WAV files when possible and decoded by FFmpeg otherwise
 	struct Track {
-		FFmpeg mpeg;
+		boost::scoped_ptr<WavFile> wav;
+		boost::scoped_ptr<FFmpeg> mpeg;
 		float fadeLevel;
 		float pitchFactor;
-		Track(std::string const& filename, unsigned int sr): mpeg(false, true, filename, sr), fadeLevel(1.0f), pitchFactor(0.0f) {}
+		Track(std::string const& filename, unsigned int sr): fadeLevel(1.0f), pitchFactor(0.0f) {
+			try { wav.reset(new WavFile(filename, sr)); }
+			catch (WavFile::unsupported&) { mpeg.reset(new FFmpeg(false, true, filename, sr)); }
+		}
+		/// Mix audio at interleaved sample position pos, returns false at EOF
+		bool operator()(float* begin, float* end, int64_t pos, float volume) {
+			return wav ? (*wav)(begin, end, pos, volume) : mpeg->audioQueue(begin, end, pos, volume);
+		}
+		/// Returns true when buffering is done (or will never get done due to errors)
+		bool prepare(int64_t pos) {
+			if (wav) return wav->prepare(pos);
+			return mpeg->terminating() || mpeg->audioQueue.prepare(pos);
+		}
+		double duration() const { return wav ? wav->duration() : mpeg->audioQueue.duration(); }
 	};
 	typedef boost::ptr_map<std::string, Track> Tracks;
 	Tracks tracks; ///< Audio decoders
@@ -176,7 +192,7 @@ public:
 			if (t.pitchFactor != 0) { // Pitch shift
 				Buffer tempbuf(end - begin);
 				// Get audio to temp buffer
-				if (t.mpeg.audioQueue(&*tempbuf.begin(), &*tempbuf.end(), m_pos, t.fadeLevel)) eof = false;
+				if (t(&*tempbuf.begin(), &*tempbuf.end(), m_pos, t.fadeLevel)) eof = false;
 				// Do the magic
 				PitchShift(&*tempbuf.begin(), &*tempbuf.end(), t.pitchFactor);
 				// Mix with other tracks
@@ -187,7 +203,7 @@ public:
 			// Otherwise just get the audio and mix it straight away
 			} else
 #endif
-			if (t.mpeg.audioQueue(&*mixbuf.begin(), &*mixbuf.end(), m_pos, t.fadeLevel)) eof = false;
+			if (t(&*mixbuf.begin(), &*mixbuf.end(), m_pos, t.fadeLevel)) eof = false;
 		}
 		m_pos += samples;
 		for (size_t i = 0, iend = mixbuf.size(); i != iend; ++i) {
@@ -206,7 +222,7 @@ public:
 	double duration() const {
 		double dur = 0.0;
 		for (Tracks::const_iterator it = tracks.begin(), itend = tracks.end(); it != itend; ++it) {
-			dur = std::max(dur, it->second->mpeg.audioQueue.duration());
+			dur = std::max(dur, it->second->duration());
 		}
 		return dur;
 	}
@@ -214,9 +230,7 @@ public:
 	bool prepare() {
 		bool ready = true;
 		for (Tracks::iterator it = tracks.begin(), itend = tracks.end(); it != itend; ++it) {
-			FFmpeg& mpeg = it->second->mpeg;
-			if (mpeg.terminating()) continue;  // Song loading failed or other error, won't ever get ready
-			if (mpeg.audioQueue.prepare(m_pos)) continue;  // Buffering done
+			if (it->second->prepare(m_pos)) continue;  // Buffering done (or failed and won't ever get ready)
 			ready = false;  // Need to wait for buffering
 			break;
 		}
@@ -0,0 +1,72 @@
+#include "benchmark.hh"
+
+#include "fs.hh"
+#include "midifile.hh"
+#include "xtime.hh"
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/format.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	void find(fs::path const& dir, std::vector<std::string>& files) {
+		for (fs::directory_iterator dirIt(dir), dirEnd; dirIt != dirEnd; ++dirIt) {
+			fs::path p = dirIt->path();
+			if (fs::is_directory(p)) { find(p, files); continue; }
+#if BOOST_FILESYSTEM_VERSION < 3
+			std::string ext = p.extension();
+#else
+			std::string ext = p.extension().string();
+#endif
+			boost::algorithm::to_lower(ext);
+			if (ext == ".mid" || ext == ".midi") files.push_back(p.string());
+		}
+	}
+}
+
+int benchMidi(BenchArgs const& args) {
+	if (args.empty()) throw std::runtime_error("No MIDI file or folder given");
+	unsigned rounds = benchArg(args, 1, 3);
+	std::vector<std::string> files;
+	if (fs::is_directory(args[0])) find(args[0], files); else files.push_back(args[0]);
+	std::size_t bytes = 0;
+	for (std::size_t i = 0; i < files.size(); ++i) bytes += fs::file_size(files[i]);
+	BenchStats parse("read file"), convert("note times to seconds");
+	unsigned failed = 0;
+	unsigned long notes = 0, tempos = 0;
+	boost::uint64_t check = 0;  // Keeps the conversions from being optimized away
+	// The first round only brings the files into the disk cache (unless there is just one)
+	for (unsigned round = (rounds > 1 ? 0 : 1); round <= rounds; ++round) {
+		bool record = round > 0;
+		for (std::size_t i = 0; i < files.size(); ++i) {
+			try {
+				boost::xtime t = now();
+				MidiFileParser midi(files[i]);
+				if (record) parse.add(now() - t);
+				// Convert note times the way the song parser does (pitch by pitch, lyrics in order)
+				t = now();
+				unsigned long n = 0;
+				for (MidiFileParser::Tracks::const_iterator it = midi.tracks.begin(); it != midi.tracks.end(); ++it) {
+					for (MidiFileParser::NoteMap::const_iterator it2 = it->notes.begin(); it2 != it->notes.end(); ++it2) {
+						for (MidiFileParser::Notes::const_iterator it3 = it2->second.begin(); it3 != it2->second.end(); ++it3, ++n) {
+							check += midi.get_us(it3->begin) + midi.get_us(it3->end);
+						}
+					}
+					for (MidiFileParser::Lyrics::const_iterator it2 = it->lyrics.begin(); it2 != it->lyrics.end(); ++it2, ++n) {
+						check += midi.get_us(it2->begin) + midi.get_us(it2->end);
+					}
+				}
+				if (record) convert.add(now() - t);
+				if (round == 1) { notes += n; tempos += midi.tempochanges.size(); }
+			} catch (std::exception& e) {
+				if (round == 1) { ++failed; std::clog << "bench/info: " << files[i] << ": " << e.what() << std::endl; }
+			}
+		}
+	}
+	std::cout << boost::format("%u MIDI files (%.1f MB), %u failed, %u notes and lyrics, %u tempo changes (check %u)\n\n")
+	  % files.size() % (bytes / 1e6) % failed % notes % tempos % (check % 1000);
+	parse.print(std::cout);
+	convert.print(std::cout);
+	return EXIT_SUCCESS;
+}
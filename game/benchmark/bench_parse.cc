@@ -0,0 +1,97 @@
+#include "benchmark.hh"
+
+#include "fs.hh"
+#include "song.hh"
+#include "songdir.hh"
+#include "songparser.hh"
+#include "songwatcher.hh"
+#include "xtime.hh"
+#include <boost/format.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	enum Format { TXT, INI, XML, SM, FORMATS };
+	char const* const formatNames[FORMATS] = { "txt", "ini", "xml", "sm" };
+
+	/// Same song files as the song scan looks for
+	SongDir::Rules makeRules() {
+		SongDir::Rules rules;
+		rules.add(SongDir::Rules::SUFFIX, "txt", TXT);
+		rules.add(SongDir::Rules::EXACT, "song.ini", INI);
+		rules.add(SongDir::Rules::EXACT, "notes.xml", XML);
+		rules.add(SongDir::Rules::SUFFIX, "sm", SM);
+		return rules;
+	}
+
+	struct SongFile {
+		std::string path, filename;
+		Format format;
+		std::size_t bytes;
+	};
+	typedef std::vector<SongFile> SongFiles;
+
+	void find(fs::path const& dir, SongDir::Rules const& rules, SongFiles& files) {
+		for (fs::directory_iterator dirIt(dir), dirEnd; dirIt != dirEnd; ++dirIt) {
+			fs::path p = dirIt->path();
+			if (fs::is_directory(p)) { find(p, rules, files); continue; }
+#if BOOST_FILESYSTEM_VERSION < 3
+			std::string name = p.leaf();
+#else
+			std::string name = p.filename().string();
+#endif
+			int kind = rules.classify(name);
+			if (kind < 0) continue;
+			SongFile f = { SongWatcher::dirKey(dir), name, Format(kind), std::size_t(fs::file_size(p)) };
+			files.push_back(f);
+		}
+	}
+}
+
+int benchParse(BenchArgs const& args) {
+	if (args.empty()) throw std::runtime_error("No song folder given");
+	unsigned rounds = benchArg(args, 1, 3);
+	SongFiles files;
+	find(args[0], makeRules(), files);
+	std::size_t bytes[FORMATS] = {}, count[FORMATS] = {};
+	for (SongFiles::const_iterator it = files.begin(); it != files.end(); ++it) { bytes[it->format] += it->bytes; ++count[it->format]; }
+	std::cout << files.size() << " song files:";
+	for (unsigned f = 0; f < FORMATS; ++f) std::cout << boost::format(" %u %s (%.1f MB)") % count[f] % formatNames[f] % (bytes[f] / 1e6);
+	std::cout << "\n" << std::endl;
+	std::vector<BenchStats> header, full;
+	for (unsigned f = 0; f < FORMATS; ++f) {
+		header.push_back(BenchStats(std::string(formatNames[f]) + ", header"));
+		full.push_back(BenchStats(std::string(formatNames[f]) + ", all notes"));
+	}
+	unsigned failed = 0;
+	double total = 0.0;
+	// The first round only brings the files into the disk cache (unless there is just one)
+	for (unsigned round = (rounds > 1 ? 0 : 1); round <= rounds; ++round) {
+		bool record = round > 0;
+		SongDir::Scan dirScan;  // As in the song scan (folder listings are shared)
+		boost::xtime begin = now();
+		for (SongFiles::const_iterator it = files.begin(); it != files.end(); ++it) {
+			try {
+				// Header only, as when scanning for songs
+				boost::xtime t = now();
+				Song song(it->path, it->filename);
+				if (record) header[it->format].add(now() - t);
+				// The rest, as when the song is played
+				t = now();
+				SongParser sp(song);
+				if (record) full[it->format].add(now() - t);
+			} catch (std::exception& e) {
+				if (round == 1) { ++failed; std::clog << "bench/info: " << it->path << it->filename << ": " << e.what() << std::endl; }
+			}
+		}
+		if (record) total += now() - begin;
+	}
+	for (unsigned f = 0; f < FORMATS; ++f) { if (header[f].size()) header[f].print(std::cout); }
+	for (unsigned f = 0; f < FORMATS; ++f) { if (full[f].size()) full[f].print(std::cout); }
+	std::size_t allBytes = bytes[TXT] + bytes[INI] + bytes[XML] + bytes[SM];
+	std::cout << boost::format("\n%u files failed to parse, %.1f files/s, %.1f MB/s (header and notes)\n")
+	  % failed % (rounds * files.size() / std::max(total, 1e-9)) % (rounds * allBytes / 1e6 / std::max(total, 1e-9));
+	return EXIT_SUCCESS;
+}
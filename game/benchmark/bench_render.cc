@@ -0,0 +1,129 @@
+#include "benchmark.hh"
+
+#include "audio.hh"
+#include "backgrounds.hh"
+#include "configuration.hh"
+#include "controllers.hh"
+#include "database.hh"
+#include "fs.hh"
+#include "glutil.hh"
+#include "screen.hh"
+#include "screen_intro.hh"
+#include "screen_players.hh"
+#include "screen_sing.hh"
+#include "screen_songs.hh"
+#include "song.hh"
+#include "songs.hh"
+#include "songwatcher.hh"
+#include "surface.hh"
+#include "video_driver.hh"
+#include "xtime.hh"
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	/// Measurements of rendered frames
+	struct Frames {
+		Frames(): draw("draw (render + glFinish)"), frame("frame (with swap and loading)") {}
+		BenchStats draw, frame;
+		std::vector<unsigned long> calls, binds;
+	};
+
+	void printCounts(std::string const& name, std::vector<unsigned long> counts) {
+		if (counts.empty()) return;
+		std::sort(counts.begin(), counts.end());
+		std::cout << boost::format("%-32s per frame: median %u, max %u\n") % name % counts[counts.size() / 2] % counts.back();
+	}
+
+	/// Run frames the way the main loop does; Songs (if given) is advanced to keep the cover flow moving
+	void render(ScreenManager& sm, unsigned frames, Songs* songs, Frames* result) {
+		Window& window = sm.window();
+		for (unsigned i = 0; i < frames; ++i) {
+			if (songs && i % 15 == 0) songs->advance(1);
+			boost::xtime begin = now();
+			sm.updateScreen();
+			unsigned long calls = glutil::drawCalls(), binds = glutil::textureBinds();
+			boost::xtime t = now();
+			window.render(boost::bind(&ScreenManager::drawScreen, &sm));
+			glFinish();
+			double draw = now() - t;
+			calls = glutil::drawCalls() - calls;
+			binds = glutil::textureBinds() - binds;
+			window.swap();
+			updateSurfaces();
+			sm.prepareScreen();
+			SDL_Event event;
+			while (SDL_PollEvent(&event) == 1) {}  // Input is ignored
+			if (!result) continue;
+			result->draw.add(draw);
+			result->frame.add(now() - begin);
+			result->calls.push_back(calls);
+			result->binds.push_back(binds);
+		}
+	}
+
+	/// Instruments for the band (in addition to any enabled keyboard instruments)
+	void addInstruments() {
+		using namespace input;
+		std::vector<int> mapping;
+		detail::devices.insert(std::make_pair(0x10000u, detail::InputDevPrivate(Instrument("BENCH_GUITAR", GUITAR, mapping))));
+		detail::devices.insert(std::make_pair(0x10001u, detail::InputDevPrivate(Instrument("BENCH_BASS", GUITAR, mapping))));
+		detail::devices.insert(std::make_pair(0x10002u, detail::InputDevPrivate(Instrument("BENCH_DRUMS", DRUMS, mapping))));
+	}
+}
+
+int benchRender(BenchArgs const& args) {
+	std::string mode = args.empty() ? "" : args[0];
+	if (mode != "songs" && mode != "sing") throw std::runtime_error("Give songs or sing <song file>");
+	if (mode == "sing" && args.size() < 2) throw std::runtime_error("No song file given");
+	unsigned frames = benchArg(args, mode == "sing" ? 2 : 1, 600);
+	fs::path songFile = mode == "sing" ? fs::path(args[1]) : fs::path();
+	if (mode == "sing") config["paths/songs"].sl().clear();  // No song scan running in the background
+	fs::path dbFile = getCacheDir() / "benchmark-database.xml";  // Keep the player's database untouched
+	Frames result;
+	unsigned songCount = 0;
+	{
+		Audio audio;
+		Window window(config["graphic/window_width"].i(), config["graphic/window_height"].i(), false);
+		Backgrounds backgrounds;
+		Database database(dbFile);
+		Songs songs(database);
+		ScreenManager sm(window);
+		addInstruments();
+		sm.addScreen(new ScreenIntro("Intro", audio));
+		sm.addScreen(new ScreenSongs("Songs", audio, songs, database));
+		sm.addScreen(new ScreenSing("Sing", audio, database, backgrounds));
+		sm.addScreen(new ScreenPlayers("Players", audio, database));
+		if (mode == "songs") {
+			sm.activateScreen("Songs");
+			while (songs.loading()) render(sm, 10, NULL, NULL);  // Wait for the song scan
+			render(sm, 60, NULL, NULL);  // Let the first covers load
+			songCount = songs.size();
+			render(sm, frames, &songs, &result);
+		} else {
+#if BOOST_FILESYSTEM_VERSION < 3
+			std::string filename = songFile.leaf();
+#else
+			std::string filename = songFile.filename().string();
+#endif
+			boost::shared_ptr<Song> song(new Song(SongWatcher::dirKey(songFile.parent_path()), filename));
+			dynamic_cast<ScreenSing&>(*sm.getScreen("Sing")).setSong(song);
+			sm.activateScreen("Sing");
+			render(sm, 60, NULL, NULL);  // Let the graphics load
+			render(sm, frames, NULL, &result);
+		}
+	}
+	fs::remove(dbFile);
+	fs::remove(fs::path(dbFile).replace_extension(".journal"));
+	if (mode == "songs") std::cout << songCount << " songs in the song browser\n\n";
+	result.draw.print(std::cout);
+	result.frame.print(std::cout);
+	printCounts("draw calls", result.calls);
+	printCounts("texture binds", result.binds);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include "benchmark.hh"
+
+#include "searchindex.hh"
+#include "songmeta.hh"
+#include "unicode.hh"
+#include "xtime.hh"
+#include <boost/format.hpp>
+#include <boost/regex.hpp>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+	char const* const words[] = {
+		"love", "night", "heart", "dance", "fire", "baby", "time", "world", "dream", "light",
+		"girl", "boy", "summer", "rain", "blue", "golden", "wild", "crazy", "forever", "tonight",
+		"rock", "roll", "star", "moon", "sun", "city", "road", "home", "river", "ocean",
+		"the", "of", "my", "in", "and", "you", "me", "we", "no", "all",
+		"Björk", "Beyoncé", "Motörhead", "Rós", "Mötley", "Café", "Niño", "Señorita", "Ölle", "Déjà"
+	};
+	char const* const genres[] = { "Pop", "Rock", "Metal", "Jazz", "Schlager", "Dance", "Hip Hop", "Folk", "Soundtrack", "Disco" };
+	char const* const editions[] = { "SingStar", "SingStar '80s", "SingStar Rocks!", "Guitar Hero", "Rock Band 2", "FoF", "UltraStar", "Custom" };
+	template <typename T, std::size_t N> std::size_t countof(T const (&)[N]) { return N; }
+
+	std::string phrase(unsigned minWords, unsigned maxWords) {
+		std::string str;
+		for (unsigned i = 0, n = minWords + std::rand() % (maxWords - minWords + 1); i < n; ++i) {
+			if (i) str += ' ';
+			str += words[std::rand() % countof(words)];
+		}
+		return str;
+	}
+
+	/// Same as Songs::strFull
+	std::string strFull(SongMeta const& s, StringPool const& strings) {
+		return strings.str(s.title) + "\n" + strings.str(s.artist) + "\n" + strings.str(s.genre) + "\n" + strings.str(s.edition) + "\n" + strings.str(s.path);
+	}
+
+	/// Queries, typed into the song browser one character at a time
+	char const* const queries[] = { "love", "the night", "bjork", "motorhead fire", "a", "rock", "singstar 80", "beyonce halo", "zzz", "golden river" };
+}
+
+int benchSearch(BenchArgs const& args) {
+	unsigned count = benchArg(args, 0, 50000);
+	std::srand(1);  // The same songs on every run
+	StringPool strings;
+	std::vector<SongMeta> songs(count);
+	for (unsigned i = 0; i < count; ++i) {
+		SongMeta& s = songs[i];
+		std::string artist = phrase(1, 3), title = phrase(1, 5);
+		s.artist = strings.intern(artist);
+		s.title = strings.intern(title);
+		s.genre = strings.intern(genres[std::rand() % countof(genres)]);
+		s.edition = strings.intern(editions[std::rand() % countof(editions)]);
+		s.path = strings.intern("/songs/" + artist + " - " + title + "/");
+	}
+	// Index the songs the same way as Songs does while scanning
+	boost::xtime t = now();
+	SearchIndex index;
+	for (unsigned i = 0; i < count; ++i) index.add(unicodeSearchKey(strFull(songs[i], strings)));
+	std::cout << boost::format("%u songs, search index built in %.1f ms\n\n") % count % (1e3 * (now() - t));
+	BenchStats typing("index, per keystroke"), fresh("index, new query"), slow("regex, per keystroke");
+	for (std::size_t q = 0; q < countof(queries); ++q) {
+		std::string query = queries[q];
+		std::size_t found = 0;
+		for (std::size_t len = 1; len <= query.size(); ++len) {
+			t = now();
+			found = index.find(unicodeSearchKey(query.substr(0, len))).size();
+			typing.add(now() - t);
+		}
+		std::cout << boost::format("  %-20s %7u songs\n") % ("\"" + query + "\"") % found;
+	}
+	// Each query differs from the previous one, so nothing can be narrowed
+	for (unsigned round = 0; round < 10; ++round) {
+		for (std::size_t q = 0; q < countof(queries); ++q) {
+			t = now();
+			index.find(unicodeSearchKey(queries[q]));
+			fresh.add(now() - t);
+		}
+	}
+	// The opt-in regex mode (game/search_regex), which is how every search was done before the index
+	for (std::size_t q = 0; q < countof(queries); ++q) {
+		std::string query = queries[q];
+		for (std::size_t len = 1; len <= query.size(); ++len) {
+			t = now();
+			boost::regex expression(query.substr(0, len), boost::regex_constants::icase);
+			std::size_t found = 0;
+			for (unsigned i = 0; i < count; ++i) found += regex_search(strFull(songs[i], strings), expression);
+			slow.add(now() - t);
+		}
+	}
+	std::cout << std::endl;
+	typing.print(std::cout);
+	fresh.print(std::cout);
+	slow.print(std::cout);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include "benchmark.hh"
+
+#include "configuration.hh"
+#include "fs.hh"
+#include "log.hh"
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+void BenchStats::print(std::ostream& os) const {
+	if (m_samples.empty()) { os << boost::format("%-32s no runs") % m_name << std::endl; return; }
+	std::vector<double> s = m_samples;
+	std::sort(s.begin(), s.end());
+	double total = 0.0;
+	for (std::size_t i = 0; i < s.size(); ++i) total += s[i];
+	os << boost::format("%-32s %7u runs   median %9.3f ms   p95 %9.3f ms   max %9.3f ms   total %9.1f ms")
+	  % m_name % s.size() % (1e3 * s[s.size() / 2]) % (1e3 * s[s.size() * 95 / 100]) % (1e3 * s.back()) % (1e3 * total) << std::endl;
+}
+
+unsigned benchArg(BenchArgs const& args, std::size_t i, unsigned def) {
+	if (i >= args.size()) return def;
+	try { return boost::lexical_cast<unsigned>(args[i]); }
+	catch (boost::bad_lexical_cast&) { throw std::runtime_error("Invalid number: " + args[i]); }
+}
+
+namespace {
+	struct Benchmark {
+		char const* name;
+		char const* usage;
+		bool config; ///< needs the game configuration and data paths
+		int (*run)(BenchArgs const&);
+	};
+	Benchmark const benchmarks[] = {
+		{ "search", "[songs=50000]  Song browser search over synthetic songs", false, benchSearch },
+		{ "parse", "<folder> [rounds=3]  Parse all song files (txt, ini, xml, sm) found in a folder", true, benchParse },
+		{ "midi", "<file or folder> [rounds=3]  Read MIDI charts (e.g. FoF and Rock Band notes.mid)", false, benchMidi },
+		{ "render", "songs [frames=600] | sing <song file> [frames=600]  Draw calls and frame times of the song browser or a song with a band", true, benchRender }
+	};
+	std::size_t const benchmarkCount = sizeof(benchmarks) / sizeof(*benchmarks);
+}
+
+int main(int argc, char** argv) try {
+	std::ios::sync_with_stdio(false);  // We do not use C stdio
+	logger::setup(logger::default_log_level);
+	atexit(logger::teardown);
+	std::string name = argc > 1 ? argv[1] : "";
+	BenchArgs args(argv + std::min(argc, 2), argv + argc);
+	for (std::size_t i = 0; i < benchmarkCount; ++i) {
+		if (name != benchmarks[i].name) continue;
+		if (benchmarks[i].config) {
+			readConfig();
+			getPaths();  // Initialize paths before other threads start
+		}
+		return benchmarks[i].run(args);
+	}
+	std::cout << "Usage: " << argv[0] << " <benchmark> [arguments]\n\nBenchmarks:\n";
+	for (std::size_t i = 0; i < benchmarkCount; ++i) std::cout << "  " << benchmarks[i].name << " " << benchmarks[i].usage << "\n";
+	std::cout << std::endl;
+	return name.empty() || name == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+} catch (std::exception& e) {
+	std::cerr << "FATAL ERROR: " << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/// Command line arguments of a benchmark (the ones after its name)
+typedef std::vector<std::string> BenchArgs;
+
+/// Timings of repeated runs of one operation
+class BenchStats {
+  public:
+	explicit BenchStats(std::string const& name): m_name(name) {}
+	/// record the duration of one run (in seconds)
+	void add(double t) { m_samples.push_back(t); }
+	/// number of runs
+	std::size_t size() const { return m_samples.size(); }
+	/// print the number of runs, median, 95th percentile, maximum and total duration
+	void print(std::ostream& os) const;
+  private:
+	std::string m_name;
+	std::vector<double> m_samples;
+};
+
+/// argument number i as an unsigned integer, or def if not given
+unsigned benchArg(BenchArgs const& args, std::size_t i, unsigned def);
+
+// Benchmarks (the return value is the exit status)
+int benchSearch(BenchArgs const& args);
+int benchParse(BenchArgs const& args);
+int benchMidi(BenchArgs const& args);
+int benchRender(BenchArgs const& args);
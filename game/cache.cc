@@ -1,18 +1,45 @@
 #include "cache.hh"
 #include "fs.hh"
+#include "surface.hh"
 
+#include <boost/cstdint.hpp>
 #include <boost/format.hpp>
 #include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
 #include <boost/algorithm/string/classification.hpp>
 
+namespace {
+	/// Header of a raw cache file, followed by the pixels exactly as they are uploaded to OpenGL
+	struct RawHeader {
+		char magic[8];
+		boost::uint32_t byteOrder; ///< Pixels are stored in native byte order, so files from other machines are rejected
+		boost::uint32_t width, height;
+		boost::uint32_t format; ///< pix::Format
+		boost::int64_t mtime; ///< Modification time of the source file
+		double lod; ///< Rasterization scale factor or thumbnail size
+	};
+	char const rawMagic[8] = { 'U', 'S', 'R', 'A', 'W', '\0', '\0', '\1' };
+	boost::uint32_t const rawByteOrder = 0x01020304;
+
+	/// Location under a cache subdirectory that mirrors the full path of the original (avoids name collisions)
+	fs::path mirrorDir(std::string const& subdir, fs::path const& filename) {
+		std::string fullpath = filename.parent_path().string();
+		// Windows drive name handling
+		std::replace_if(fullpath.begin(), fullpath.end(), boost::is_any_of(":"), '_');
+		return getCacheDir() / subdir / fullpath;
+	}
+}
+
 namespace cache {
-	fs::path constructSVGCacheFileName(fs::path const& svgfilename, double factor){
+	fs::path constructSVGCacheFileName(fs::path const& svgfilename, double factor, std::string const& ext){
 		fs::path cache_filename;
 		std::string const lod = (boost::format("%.2f") % factor).str();
 #if BOOST_FILESYSTEM_VERSION < 3
-		std::string const cache_basename = svgfilename.filename() + ".cache_" + lod + ".png";
+		std::string const cache_basename = svgfilename.filename() + ".cache_" + lod + ext;
 #else
-		std::string const cache_basename = svgfilename.filename().string() + ".cache_" + lod + ".png";
+		std::string const cache_basename = svgfilename.filename().string() + ".cache_" + lod + ext;
 #endif
 
 		if (isThemeResource(svgfilename)) {
@@ -21,13 +48,60 @@ namespace cache {
 		} else {
 			// We use the full path under cache to avoid name collisions
 			// with images other than theme files (mostly backgrounds).
-			std::string fullpath = svgfilename.parent_path().string();
-			// Windows drive name handling
-			std::replace_if(fullpath.begin(), fullpath.end(), boost::is_any_of(":"), '_');
-			cache_filename = getCacheDir() / "misc" / fullpath / cache_basename;
+			cache_filename = mirrorDir("misc", svgfilename) / cache_basename;
 		}
 
 		return cache_filename;
 	}
 
+	fs::path constructThumbnailFileName(fs::path const& filename, unsigned size) {
+		std::string const suffix = (boost::format(".thumb_%u.raw") % size).str();
+#if BOOST_FILESYSTEM_VERSION < 3
+		return mirrorDir("thumbnails", filename) / (filename.filename() + suffix);
+#else
+		return mirrorDir("thumbnails", filename) / (filename.filename().string() + suffix);
+#endif
+	}
+
+	bool loadRaw(Bitmap& bitmap, fs::path const& cache_filename, fs::path const& source_filename, double lod) {
+		std::ifstream file(cache_filename.string().c_str(), std::ios::binary);
+		if (!file) return false;
+		RawHeader h;
+		if (!file.read(reinterpret_cast<char*>(&h), sizeof(h))) return false;
+		if (!std::equal(rawMagic, rawMagic + sizeof(rawMagic), h.magic) || h.byteOrder != rawByteOrder) return false;
+		if (h.mtime != boost::int64_t(fs::last_write_time(source_filename)) || std::abs(h.lod - lod) > 1e-6) return false;
+		if (h.format > pix::BGR || h.width == 0 || h.height == 0 || h.width > 16384 || h.height > 16384) return false;
+		// Read the pixels straight into the bitmap, no decoding needed
+		bitmap.resize(h.width, h.height);
+		bitmap.fmt = pix::Format(h.format);
+		if (!file.read(reinterpret_cast<char*>(&bitmap.buf[0]), bitmap.buf.size())) return false;
+		return true;
+	}
+
+	void saveRaw(Bitmap const& bitmap, fs::path const& cache_filename, fs::path const& source_filename, double lod) {
+		// Write to a temporary file first so that a partial file is never loaded
+		fs::path const tmp_filename = cache_filename.string() + ".tmp";
+		try {
+			fs::create_directories(cache_filename.parent_path());
+			RawHeader h;
+			std::copy(rawMagic, rawMagic + sizeof(rawMagic), h.magic);
+			h.byteOrder = rawByteOrder;
+			h.width = bitmap.width;
+			h.height = bitmap.height;
+			h.format = bitmap.fmt;
+			h.mtime = fs::last_write_time(source_filename);
+			h.lod = lod;
+			{
+				std::ofstream file(tmp_filename.string().c_str(), std::ios::binary);
+				file.write(reinterpret_cast<char const*>(&h), sizeof(h));
+				file.write(reinterpret_cast<char const*>(&bitmap.buf[0]), bitmap.buf.size());
+				if (!file.flush()) throw std::runtime_error("Write failed");
+			}
+			if (fs::exists(cache_filename)) fs::remove(cache_filename);
+			fs::rename(tmp_filename, cache_filename);
+		} catch (std::exception& e) {
+			std::clog << "cache/warning: Unable to write " << cache_filename.string() << ": " << e.what() << std::endl;
+			try { fs::remove(tmp_filename); } catch (...) {}
+		}
+	}
 }
@@ -6,19 +6,34 @@
 #include <cstring>
 #include <stdexcept>
 
+struct Bitmap;
+
 namespace cache {
 
-	/** Builds the full path and file name for the SVG cache resource **/
-	fs::path constructSVGCacheFileName(fs::path const& svgfilename, double factor);
+	/** Builds the full path and file name for the SVG cache resource (ext is ".png" or ".raw") **/
+	fs::path constructSVGCacheFileName(fs::path const& svgfilename, double factor, std::string const& ext = ".png");
+
+	/** Builds the full path and file name for a downscaled image (thumbnail of at most size x size pixels) **/
+	fs::path constructThumbnailFileName(fs::path const& filename, unsigned size);
+
+	/** Load a bitmap from a raw cache file, returns false if the file is missing or does not match the source and lod **/
+	bool loadRaw(Bitmap& bitmap, fs::path const& cache_filename, fs::path const& source_filename, double lod);
+
+	/** Store a bitmap in a raw cache file (failures are only logged) **/
+	void saveRaw(Bitmap const& bitmap, fs::path const& cache_filename, fs::path const& source_filename, double lod);
 
-	/** Load an SVG from the cache, if loading fails invalid_cache_error is thrown **/
+	/** Load an SVG from the cache (raw or PNG), returns false if there is no valid cache file **/
 	template <typename T> bool loadSVG(T& target, fs::path const& source_filename, double factor) {
+		if (loadRaw(target, constructSVGCacheFileName(source_filename, factor, ".raw"), source_filename, factor)) return true;
+		// PNG caches written by older versions
 		fs::path const cache_filename = cache::constructSVGCacheFileName(source_filename, factor);
 		// Verify that a cached file exists and that it is more recent than the original SVG
 		if (!fs::exists(cache_filename)) return false;
 		if (fs::last_write_time(source_filename) > fs::last_write_time(cache_filename)) return false;
 		// Try to load the cached file		
 		try { loadPNG(target, cache_filename.string()); } catch( ... ) { return false; }
+		// Upgrade to the raw format, which loads faster
+		saveRaw(target, constructSVGCacheFileName(source_filename, factor, ".raw"), source_filename, factor);
 		return true;
 	}
 }
@@ -1,41 +1,93 @@
 #pragma once
-#include <boost/ptr_container/ptr_map.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 #include <list>
 
-/// caching template
-template <typename Key, typename Value> class Cachemap {
-	typedef boost::ptr_map<Key, Value> Map;
+/**
+* @short Least recently used cache.
+* Values are created on demand (constructed from the key) and owned by the cache.
+* Each value has a cost (1 by default, or e.g. its size in bytes if a cost function is given)
+* and the least recently used values are dropped when the total cost exceeds the budget.
+* Costs are re-evaluated on every access, so values may grow after insertion (e.g. when loaded).
+* All operations are O(1), apart from the evictions that they cause.
+**/
+template <typename Key, typename Value> class Cachemap: boost::noncopyable {
+  public:
+	typedef boost::function<std::size_t (Value const&)> CostFunc;
+  private:
+	typedef std::list<Key> History;
+	struct Entry {
+		Value* value;
+		std::size_t cost;
+		typename History::iterator pos; ///< Position in m_history
+	};
+	typedef boost::unordered_map<Key, Entry> Map;
 	Map m_map;
-	std::list<Key> m_history;
-	std::size_t m_size;
-	void access(Key const& key) {
-		m_history.remove(key);
-		while (m_history.size() >= m_size) { m_map.erase(m_history.front()); m_history.pop_front(); }
-		m_history.push_back(key);
+	History m_history; ///< Least recently used first
+	CostFunc m_costFunc;
+	std::size_t m_budget, m_cost;
+	unsigned long m_hits, m_misses, m_evictions;
+	std::size_t cost(Value const& value) const { return m_costFunc ? m_costFunc(value) : 1; }
+	/// Mark the entry as most recently used, update its cost and make room within the budget
+	void access(typename Map::iterator it) {
+		Entry& e = it->second;
+		m_history.splice(m_history.end(), m_history, e.pos);
+		std::size_t c = cost(*e.value);
+		m_cost = m_cost - e.cost + c;
+		e.cost = c;
+		// Never evict the entry being accessed (the caller holds a reference to it)
+		while (m_cost > m_budget && m_history.size() > 1) {
+			erase(m_map.find(m_history.front()));
+			++m_evictions;
+		}
+	}
+	void erase(typename Map::iterator it) {
+		Entry& e = it->second;
+		m_cost -= e.cost;
+		m_history.erase(e.pos);
+		delete e.value;
+		m_map.erase(it);
 	}
 
   public:
-	/// constructor
-	Cachemap(std::size_t size): m_size(size) {}
-	/// inserts key:value pairs
-	typename Map::iterator insert(Key key, Value* value) {
-		access(key);
-		return m_map.insert(key, value).first;
+	/// constructor, budget is the maximum total cost (number of entries if there is no cost function)
+	Cachemap(std::size_t budget, CostFunc const& costFunc = CostFunc()):
+	  m_costFunc(costFunc), m_budget(budget), m_cost(), m_hits(), m_misses(), m_evictions() {}
+	~Cachemap() { clear(); }
+	/// inserts key:value pairs (replacing any old value), the cache takes ownership of value
+	Value& insert(Key const& key, Value* value) {
+		typename Map::iterator it = m_map.find(key);
+		if (it != m_map.end()) erase(it);
+		Entry e = { value, 0, m_history.insert(m_history.end(), key) };
+		access(m_map.insert(std::make_pair(key, e)).first);
+		return *value;
 	}
 	/// array access
 	Value& operator[](Key const& key) {
 		typename Map::iterator it = m_map.find(key);
-		if (it == m_map.end()) it = insert(key, new Value(key)); else access(key);
-		return *it->second;
+		if (it == m_map.end()) {
+			++m_misses;
+			return insert(key, new Value(key));
+		}
+		++m_hits;
+		access(it);
+		return *it->second.value;
 	}
 	/// does it have a certain key
 	bool contains(Key const& key) const {
 		return m_map.find(key) != m_map.end();
 	}
-	/// clears history and cachemap
+	/// clears history and cachemap (statistics are kept)
 	void clear() {
-		m_history.clear();
-		m_map.clear();
+		while (!m_map.empty()) erase(m_map.begin());
 	}
+	/// change the budget (takes effect on the next access)
+	void budget(std::size_t budget) { m_budget = budget; }
+	std::size_t budget() const { return m_budget; }
+	std::size_t cost() const { return m_cost; } ///< total cost of the values
+	std::size_t size() const { return m_map.size(); } ///< number of values
+	unsigned long hits() const { return m_hits; }
+	unsigned long misses() const { return m_misses; }
+	unsigned long evictions() const { return m_evictions; }
 };
-
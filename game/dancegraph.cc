@@ -1,5 +1,6 @@
 #include "dancegraph.hh"
 #include "song.hh"
+#include "songtimelines.hh"
 #include "i18n.hh"
 
 #include <boost/lexical_cast.hpp>
@@ -230,11 +231,9 @@ bool DanceGraph::difficulty(DanceDifficulty level, bool check_only) {
 	DanceDifficultyMap const& ddm = m_song.danceTracks.find(m_gamingMode)->second;
 	if (ddm.find(level) == ddm.end()) return false;
 	else if (check_only) return true;
-	m_notes.clear();
-	DanceTrack const& track = ddm.find(level)->second;
-	for(Notes::const_iterator it = track.notes.begin(); it != track.notes.end(); ++it)
-		m_notes.push_back(DanceNote(*it));
-	std::sort(m_notes.begin(), m_notes.end(), lessEnd()); // for engine's iterators
+	DanceNotes const* prepared = NULL;
+	if (m_song.timelines) prepared = SongTimelines::find(m_song.timelines->dance, m_gamingMode, level);
+	if (prepared) m_notes = *prepared; else buildNotes(m_notes, ddm.find(level)->second);
 	m_notesIt = m_notes.begin();
 	m_level = level;
 	for(size_t i = 0; i < max_panels; i++) m_activeNotes[i] = m_notes.end();
@@ -245,6 +244,23 @@ bool DanceGraph::difficulty(DanceDifficulty level, bool check_only) {
 	return true;
 }
 
+/// Construct DanceNotes of a track, sorted for the engine's iterators
+void DanceGraph::buildNotes(DanceNotes& notes, DanceTrack const& track) {
+	notes.clear();
+	for(Notes::const_iterator it = track.notes.begin(); it != track.notes.end(); ++it)
+		notes.push_back(DanceNote(*it));
+	std::sort(notes.begin(), notes.end(), lessEnd());
+}
+
+/// Build the notes of the game mode and difficulty that the constructor selects
+void DanceGraph::prepare(Song const& song, SongTimelines& timelines) {
+	DanceTracks::const_iterator it = song.danceTracks.find("dance-single");
+	if (it == song.danceTracks.end()) it = song.danceTracks.begin();
+	if (it == song.danceTracks.end() || it->second.empty()) return;
+	DanceDifficultyMap::const_iterator level = it->second.begin();  // The lowest (see changeDifficulty())
+	buildNotes(timelines.dance[SongTimelines::Key(it->first, level->first)], level->second);
+}
+
 /// Handles input and some logic
 void DanceGraph::engine() {
 	double time = m_audio.getPosition();
@@ -392,8 +408,7 @@ namespace {
 
 /// Draw a dance pad icon using the given texture
 void DanceGraph::drawArrow(int arrow_i, Texture& tex, float ty1, float ty2) {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(tex.type(), tex.id());
+	glutil::bindTexture(tex.type(), tex.id());
 	glutil::VertexArray va;
 	vertexPair(va, arrow_i, -arrowSize, ty1);
 	vertexPair(va, arrow_i,  arrowSize, ty2);
@@ -502,8 +517,7 @@ void DanceGraph::drawNote(DanceNote& note, double time) {
 			// Draw begin
 			drawArrow(arrow_i, m_arrows_hold, 0.0f, 1.0f/3.0f);
 			if (yEnd - yBeg > 0) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(m_arrows_hold.type(), m_arrows_hold.id());
+				glutil::bindTexture(m_arrows_hold.type(), m_arrows_hold.id());
 				glutil::VertexArray va;
 				// Middle
 				vertexPair(va, arrow_i, arrowSize, 1.0f/3.0f);
@@ -5,6 +5,7 @@
 #include "instrumentgraph.hh"
 
 class Song;
+struct SongTimelines;
 
 struct DanceNote {
 	DanceNote(Note note) :
@@ -36,6 +37,8 @@ class DanceGraph: public InstrumentGraph {
 	std::string getModeId() const;
 	void changeTrack(int dir = 1);
 	void changeDifficulty(int dir = 1);
+	/// Build the notes that new graphs start with (does not use OpenGL, any thread)
+	static void prepare(Song const& song, SongTimelines& timelines);
 
   private:
 	// Difficulty & mode selection
@@ -45,6 +48,7 @@ class DanceGraph: public InstrumentGraph {
 	void setTrack(const std::string& track);
 	void finalizeTrackChange();
 	bool difficulty(DanceDifficulty level, bool check_only = false);
+	static void buildNotes(DanceNotes& notes, DanceTrack const& track);
 	DanceDifficulty m_level;
 	std::string m_gamingMode; /// current game mode
 	DanceTracks::const_iterator m_curTrackIt; /// iterator to the currently selected game mode
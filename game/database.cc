@@ -1,28 +1,135 @@
 #include "database.hh"
 #include "i18n.hh"
 
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <iostream>
 #include <libxml++/libxml++.h>
 
+namespace {
+	fs::path journalFile(fs::path filename) { return filename.replace_extension(".journal"); }
+	std::string str(int value) { return boost::lexical_cast<std::string>(value); }
+
+	Journal::Record record(PlayerItem const& p) {
+		Journal::Record r;
+		r.push_back("player"); r.push_back(str(p.id)); r.push_back(p.name); r.push_back(p.picture);
+		return r;
+	}
+
+	Journal::Record record(SongItem const& s) {
+		Journal::Record r;
+		r.push_back("song"); r.push_back(str(s.id)); r.push_back(s.artist); r.push_back(s.title);
+		return r;
+	}
+
+	/// Collects the records of a journal
+	struct Collect {
+		std::vector<Journal::Record>& records;
+		Collect(std::vector<Journal::Record>& r): records(r) {}
+		void operator()(Journal::Record const& r) { records.push_back(r); }
+	};
+
+	Journal::Record record(HiscoreItem const& h) {
+		Journal::Record r;
+		r.push_back("hiscore"); r.push_back(str(h.score)); r.push_back(str(h.playerid)); r.push_back(str(h.songid)); r.push_back(h.track);
+		return r;
+	}
+}
+
 Database::Database(fs::path filename) :
-	m_filename(filename)
+	m_filename(filename),
+	m_journal(journalFile(filename)),
+	m_journaledPlayers(),
+	m_journaledSongs(),
+	m_journaledHiscores(),
+	m_changed(),
+	m_loadFailed()
 {
 	try { load(); }
 	catch(std::exception const& e) {
 		std::cerr << "Could not load " << file() << ": " << e.what() << std::endl;
-		std::cerr << "will try to create" << std::endl;
+		std::cerr << "nothing will be saved during this session" << std::endl;
+		m_loadFailed = true;
 	}
 }
 
 Database::~Database() {
-	try { save(); }
-	catch (std::exception const& e) {
+	if (m_loadFailed) return;  // Saving would replace the files that could not be loaded
+	try {
+		save();
+		if (m_changed) { compact(); exportXML(); }
+	} catch (std::exception const& e) {
 		std::cerr << "Could not save " << file() << ": " << e.what() << std::endl;
 	}
 }
 
 void Database::load() {
+	if (m_journal.exists()) {
+		// Read everything first, so that a broken journal does not leave partial contents behind
+		std::vector<Journal::Record> records;
+		try {
+			m_journal.read(Collect(records));
+			std::for_each(records.begin(), records.end(), boost::bind(&Database::replay, this, _1));
+			markJournaled();
+			return;
+		} catch (std::exception& e) {
+			// Keep the unreadable file for inspection and recover from the xml file (written on the last exit)
+			std::clog << "database/error: Cannot read " << m_journal.file().string() << ": " << e.what() << std::endl;
+			fs::path bad = m_journal.file();
+			fs::rename(m_journal.file(), bad.replace_extension(".journal.bad"));
+		}
+	}
 	if (!exists(m_filename)) return;
+	importXML();
+	markJournaled();
+	compact();  // Create the journal, the xml file is no longer read
+}
+
+void Database::save() {
+	if (m_loadFailed) return;
+	std::size_t total = m_players.addedCount() + m_songs.addedCount() + m_hiscores.addedCount();
+	if (total == m_journaledPlayers + m_journaledSongs + m_journaledHiscores) return;
+	for (; m_journaledPlayers < m_players.addedCount(); ++m_journaledPlayers) m_journal.append(record(m_players.added(m_journaledPlayers)));
+	for (; m_journaledSongs < m_songs.addedCount(); ++m_journaledSongs) m_journal.append(record(m_songs.added(m_journaledSongs)));
+	for (; m_journaledHiscores < m_hiscores.addedCount(); ++m_journaledHiscores) m_journal.append(record(m_hiscores.added(m_journaledHiscores)));
+	m_journal.commit();
+	m_changed = true;
+}
+
+void Database::compact() {
+	m_journal.rewrite(records());
+	markJournaled();
+}
+
+void Database::replay(Journal::Record const& r) {
+	try {
+		if (r[0] == "player" && r.size() == 4) addPlayer(r[2], r[3], boost::lexical_cast<int>(r[1]));
+		else if (r[0] == "song" && r.size() == 4) m_songs.addSongItem(r[2], r[3], boost::lexical_cast<int>(r[1]));
+		else if (r[0] == "hiscore" && r.size() == 5) m_hiscores.addHiscore(boost::lexical_cast<int>(r[1]), boost::lexical_cast<int>(r[2]), boost::lexical_cast<int>(r[3]), r[4]);
+		else throw std::runtime_error("Unknown record");
+	} catch (std::exception const& e) {
+		// Most likely the remains of an interrupted write, skip it
+		std::clog << "database/warning: Ignoring a " << r[0] << " record in " << m_journal.file().string() << ": " << e.what() << std::endl;
+	}
+}
+
+std::vector<Journal::Record> Database::records() const {
+	// Replaying these must give identical state, so everything is kept in the order it was added
+	std::vector<Journal::Record> ret;
+	for (std::size_t i = 0; i < m_players.addedCount(); ++i) ret.push_back(record(m_players.added(i)));
+	for (std::size_t i = 0; i < m_songs.addedCount(); ++i) ret.push_back(record(m_songs.added(i)));
+	for (std::size_t i = 0; i < m_hiscores.addedCount(); ++i) ret.push_back(record(m_hiscores.added(i)));
+	return ret;
+}
+
+void Database::markJournaled() {
+	m_journaledPlayers = m_players.addedCount();
+	m_journaledSongs = m_songs.addedCount();
+	m_journaledHiscores = m_hiscores.addedCount();
+}
+
+void Database::importXML() {
 	xmlpp::DomParser domParser(m_filename.string());
 	xmlpp::Node* nodeRoot = domParser.get_document()->get_root_node();
 
@@ -36,7 +143,7 @@ void Database::load() {
 	m_songs.load(songs);
 }
 
-void Database::save() {
+void Database::exportXML() {
 	xmlpp::Document doc;
 	xmlpp::Node* nodeRoot = doc.create_root_node("performous");
 
@@ -8,6 +8,7 @@
 #include "songitems.hh"
 #include "color.hh"
 #include "fs.hh"
+#include "journal.hh"
 
 struct ScoreItem {
 	int score;
@@ -37,15 +38,21 @@ class Database
 	/**Will try to load the database.
 	  If it does not succeed the error will be ignored.
 	  Only some information will be printed on stderr.
+
+	  The database is kept in a journal next to the given xml file
+	  (same name with extension .journal). The xml file is only read
+	  if there is no journal yet.
 	  */
 	Database (fs::path filename);
 	/**Will try to save the database.
-	  This will even be done if the loading failed.
-	  It tries to create the directory above the file.
+	  Nothing is saved if the loading failed (the files are left as they are).
+	  If anything was added during the session, the journal is compacted
+	  and the xml file is exported for compatibility.
 	  */
 	~Database ();
 
-	/**Loads the whole database from xml.
+	/**Loads the whole database from the journal or, if there is none, imports the xml file.
+	  An unreadable journal is renamed to .journal.bad and the xml file is imported instead.
 	  @exception bad_cast may be thrown if xml element is not of correct type
 	  @exception xmlpp exceptions may be thrown on any parse errors
 	  @exception PlayersException if some conditions of players fail (e.g. no id)
@@ -54,10 +61,16 @@ class Database
 	  @post filled database
 	  */
 	void load();
-	/**Saves the whole database to xml.
-	  Will write out everything to the file given in the constructor, @see file()
+	/**Appends everything added since the previous save to the journal and flushes it to disk.
+	  Cheap, so it is done at the end of every song.
 	*/
 	void save();
+	/**Rewrites the journal with only the current contents (a snapshot).*/
+	void compact();
+	/**Reads the whole database from the xml file given in the constructor, @see file()*/
+	void importXML();
+	/**Writes the whole database to the xml file given in the constructor, @see file()*/
+	void exportXML();
 
 	/**The filename given by the constructor.
 	  @returns the filename used for the database.
@@ -106,7 +119,18 @@ class Database
 	bool noPlayers() const;
 
   private:
+	/// Apply a journal record
+	void replay(Journal::Record const& record);
+	/// All contents as journal records
+	std::vector<Journal::Record> records() const;
+	/// Mark everything currently in the database as journaled
+	void markJournaled();
+
 	fs::path m_filename;
+	Journal m_journal;
+	std::size_t m_journaledPlayers, m_journaledSongs, m_journaledHiscores; ///< Items already in the journal
+	bool m_changed; ///< Something was journaled during this session
+	bool m_loadFailed; ///< Nothing is saved, so that the unreadable files are not overwritten
 
 	Players m_players;
 	Hiscore m_hiscores;
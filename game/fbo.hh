@@ -7,11 +7,11 @@
 /// Frame Buffer Object class
 class FBO: boost::noncopyable {
   public:
-	/// Generate the FBO and attach a fresh texture to it
-	FBO(unsigned w, unsigned h) {
+	/// Generate the FBO and attach a fresh texture (of the given internal format) to it
+	FBO(unsigned w, unsigned h, GLint format = GL_RGBA) {
 		{
 			UseTexture tex(m_texture);
-			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
+			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, format, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
 		}
 		{
 			UseTexture tex(m_depth);
@@ -35,10 +35,12 @@ class FBO: boost::noncopyable {
 	}
 	/// Bind the FBO into use
 	void bind() {
+		glutil::flushSprites();
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, m_fbo);
 	}
 	/// Unbind any FBO
 	static void unbind() {
+		glutil::flushSprites();
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
 	}
 
@@ -42,9 +42,12 @@ void Shader::dumpInfoLog(GLuint id) {
 	std::clog << "opengl/error: Shader " << name << ": " << infoLog << std::endl;
 }
 
-Shader::Shader(std::string const& name): name(name), program(0) {}
+Shader* Shader::s_current = NULL;
+
+Shader::Shader(std::string const& name): vertPos(-1), vertTexCoord(-1), vertNormal(-1), vertColor(-1), name(name), program(0) {}
 
 Shader::~Shader() {
+	if (s_current == this) s_current = NULL;
 	glDeleteProgram(program);
 	std::for_each(shader_ids.begin(), shader_ids.end(), glDeleteShader);
 	//std::clog << "shader/info: Shader program " << (unsigned)program << " deleted." << std::endl;
@@ -111,17 +114,34 @@ Shader& Shader::link() {
 		throw std::runtime_error("Something went wrong linking the shader program.");
 	}
 	ec.check("glLinkProgram");
+	// Resolve the common locations once
+	vertPos = glGetAttribLocation(program, "vertPos");
+	vertTexCoord = glGetAttribLocation(program, "vertTexCoord");
+	vertNormal = glGetAttribLocation(program, "vertNormal");
+	vertColor = glGetAttribLocation(program, "vertColor");
+	projMatrix = Uniform(glGetUniformLocation(program, "projMatrix"));
+	mvMatrix = Uniform(glGetUniformLocation(program, "mvMatrix"));
+	normalMatrix = Uniform(glGetUniformLocation(program, "normalMatrix"));
+	colorMatrix = Uniform(glGetUniformLocation(program, "colorMatrix"));
+	sepFactor = Uniform(glGetUniformLocation(program, "sepFactor"));
+	z0 = Uniform(glGetUniformLocation(program, "z0"));
+	ec.check("locations");
 
 	return *this;
 }
 
 
 Shader& Shader::bind() {
-	glutil::GLErrorChecker ec("Shader::bind");
-	glUseProgram(program);
+	if (s_current != this) use(this);
 	return *this;
 }
 
+void Shader::use(Shader* shader) {
+	if (shader == s_current) return;
+	glUseProgram(shader ? shader->program : 0);
+	s_current = shader;
+}
+
 
 Uniform Shader::operator[](const std::string& uniform) {
 	bind();
@@ -136,14 +156,15 @@ Uniform Shader::operator[](const std::string& uniform) {
 
 void VertexArray::Draw(GLint mode) {
 	if (empty()) return;
+	flushSprites();
+	Shader* shader = Shader::current();
+	if (!shader) return;  // Nothing to draw with
 	unsigned stride = sizeof(VertexInfo);
 	glmath::vec4 const* ptr = &m_vertices[0].position;
-	GLint program;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-	GLint vertPos = glGetAttribLocation(program, "vertPos");
-	GLint vertTexCoord = glGetAttribLocation(program, "vertTexCoord");
-	GLint vertNormal = glGetAttribLocation(program, "vertNormal");
-	GLint vertColor = glGetAttribLocation(program, "vertColor");
+	GLint vertPos = shader->vertPos;
+	GLint vertTexCoord = shader->vertTexCoord;
+	GLint vertNormal = shader->vertNormal;
+	GLint vertColor = shader->vertColor;
 	if (vertPos != -1) {
 		glEnableVertexAttribArray(vertPos);
 		glVertexAttribPointer(vertPos, 4, GL_FLOAT, GL_FALSE, stride, ptr);
@@ -161,6 +182,7 @@ void VertexArray::Draw(GLint mode) {
 		glVertexAttribPointer(vertColor, 4, GL_FLOAT, GL_FALSE, stride, ptr + 3);
 	}
 	glDrawArrays(mode, 0, size());
+	countDrawCall();
 
 	if (vertPos != -1) glDisableVertexAttribArray(vertPos);
 	if (vertTexCoord != -1) glDisableVertexAttribArray(vertTexCoord);
@@ -10,6 +10,8 @@
 
 struct Uniform {
 	GLint id;
+	/// A uniform that the shader does not have (setting it does nothing)
+	Uniform(): id(-1) {}
 	explicit Uniform(GLint id): id(id) {}
 	void set(int value) { glUniform1i(id, value); }
 	void set(float value) { glUniform1f(id, value); }
@@ -39,15 +41,21 @@ struct Shader: public boost::noncopyable {
 	/** Links all compiled shaders to a shader program. */
 	Shader& link();
 
-	/** Binds the shader into use. */
+	/** Binds the shader into use (does nothing if it already is). */
 	Shader& bind();
-
-	/** Allow setting uniforms in a chain. Shader needs to be in use.*/
-
+	/** The shader in use, NULL if none. */
+	static Shader* current() { return s_current; }
+	/** Bind a shader or, with NULL, disable shaders. */
+	static void use(Shader* shader);
 
 	/** Get uniform location. Uses caching internally. */
 	Uniform operator[](const std::string& uniform);
 
+	// Locations resolved at link time, -1 (or a dummy Uniform) if the shader does not use them
+	GLint vertPos, vertTexCoord, vertNormal, vertColor; ///< Vertex attributes
+	Uniform projMatrix, mvMatrix, normalMatrix, colorMatrix; ///< Transforms and color, set by Window
+	Uniform sepFactor, z0; ///< Stereo 3D parameters, set by Window
+
 	// Some operators
 	bool operator==(const Shader& rhs) const { return program == rhs.program; }
 	bool operator!=(const Shader& rhs) const { return program != rhs.program; }
@@ -65,22 +73,23 @@ private:
 	typedef std::map<std::string, GLint> UniformMap;
 	UniformMap uniforms; ///< Cached uniform locations, use operator[] to access
 
+	static Shader* s_current; ///< Shader in use (client side cache of GL_CURRENT_PROGRAM)
+
 };
 
 
 /** Temporarily switch shader in a RAII manner. */
 struct UseShader {
-	UseShader(Shader& new_shader): m_shader(new_shader) {
-		glGetIntegerv(GL_CURRENT_PROGRAM, &m_old);
+	UseShader(Shader& new_shader): m_shader(new_shader), m_old(Shader::current()) {
 		m_shader.bind();
 	}
-	~UseShader() { glUseProgram(m_old); }
+	~UseShader() { Shader::use(m_old); }
 	/// Access the bound shader
 	Shader& operator()() { return m_shader; }
 
   private:
 	Shader& m_shader;
-	GLint m_old;
+	Shader* m_old;
 };
 
 namespace glutil {
@@ -0,0 +1,51 @@
+#include "glutil.hh"
+
+namespace {
+	const GLenum UNKNOWN = ~GLenum();
+	GLuint s_texture2D = 0;
+	GLuint s_textureRect = 0;
+	GLenum s_blend = UNKNOWN;  ///< GL_TRUE, GL_FALSE or UNKNOWN (initial state not queried)
+	GLenum s_blendSrc = UNKNOWN, s_blendDst = UNKNOWN;
+	unsigned long s_drawCalls = 0;
+	unsigned long s_textureBinds = 0;
+
+	GLuint& binding(GLenum type) {
+		if (type == GL_TEXTURE_RECTANGLE) return s_textureRect;
+		return s_texture2D;
+	}
+}
+
+void glutil::bindTexture(GLenum type, GLuint id) {
+	GLuint& bound = binding(type);
+	if (bound == id) return;
+	glBindTexture(type, id);
+	bound = id;
+	++s_textureBinds;
+}
+
+GLuint glutil::boundTexture(GLenum type) { return binding(type); }
+
+void glutil::forgetTexture(GLuint id) {
+	if (s_texture2D == id) s_texture2D = 0;
+	if (s_textureRect == id) s_textureRect = 0;
+}
+
+void glutil::blend(bool enable) {
+	GLenum value = enable ? GL_TRUE : GL_FALSE;
+	if (s_blend == value) return;
+	if (enable) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+	s_blend = value;
+}
+
+void glutil::blendFunc(GLenum src, GLenum dst) {
+	if (s_blendSrc == src && s_blendDst == dst) return;
+	glBlendFunc(src, dst);
+	s_blendSrc = src;
+	s_blendDst = dst;
+}
+
+void glutil::countDrawCall() { ++s_drawCalls; }
+
+unsigned long glutil::drawCalls() { return s_drawCalls; }
+
+unsigned long glutil::textureBinds() { return s_textureBinds; }
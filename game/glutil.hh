@@ -10,27 +10,58 @@
 
 namespace glutil {
 
+	/// Draw any sprites queued for batching (see SpriteBatch), needed before changing GL state directly
+	void flushSprites();
+
+	// Client side cache of GL state, avoiding redundant state changes and glGet* round-trips.
+	// Only texture unit 0 is used. State set with the plain GL calls bypasses the cache.
+	/// Bind a texture (GL_TEXTURE_2D or GL_TEXTURE_RECTANGLE)
+	void bindTexture(GLenum type, GLuint id);
+	/// The texture currently bound
+	GLuint boundTexture(GLenum type);
+	/// Forget a texture that is being deleted (GL unbinds it)
+	void forgetTexture(GLuint id);
+	/// Enable or disable blending
+	void blend(bool enable);
+	/// Set the blend function
+	void blendFunc(GLenum src, GLenum dst);
+
+	// Counters for performance measurements (see performous-bench)
+	/// Count a draw call (called right after each glDraw*)
+	void countDrawCall();
+	/// Number of draw calls made so far
+	unsigned long drawCalls();
+	/// Number of texture binds made through bindTexture so far (redundant binds are skipped, not counted)
+	unsigned long textureBinds();
+
 	/// wrapper struct for RAII
 	struct UseDepthTest {
 		/// enable depth test (for 3d objects)
 		UseDepthTest() {
+			flushSprites();
 			glClear(GL_DEPTH_BUFFER_BIT);
 			glEnable(GL_DEPTH_TEST);
 		}
 		~UseDepthTest() {
+			flushSprites();
 			glDisable(GL_DEPTH_TEST);
 		}
 	};
 
-	/// Checks for OpenGL error and displays it with given location info
+	/// Checks for OpenGL error and displays it with given location info.
+	/// glGetError is a driver round-trip, so this does nothing in release (NDEBUG) builds.
 	struct GLErrorChecker {
-		std::string info;
-		GLErrorChecker(std::string const& info): info(info) { check("precondition"); }
+		char const* info;
+		GLErrorChecker(char const* info): info(info) { check("precondition"); }
 		~GLErrorChecker() { check("postcondition"); }
-		void check(std::string const& what = "check()") {
+		void check(char const* what = "check()") {
+#ifdef NDEBUG
+			(void)what;
+#else
 			GLenum err = glGetError();
 			if (err == GL_NO_ERROR) return;
 			std::clog << "opengl/error: " << msg(err) << " in " << info << " " << what << std::endl;
+#endif
 		}
 		static void reset() { glGetError(); }
 		static std::string msg(GLenum err) {
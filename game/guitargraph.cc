@@ -1,6 +1,7 @@
 #include "guitargraph.hh"
 #include "fs.hh"
 #include "song.hh"
+#include "songtimelines.hh"
 #include "i18n.hh"
 
 #include <cmath>
@@ -278,12 +279,7 @@ bool GuitarGraph::difficulty(Difficulty level, bool check_only) {
 	for (InstrumentTracks::const_iterator it = m_song.instrumentTracks.begin(); it != m_song.instrumentTracks.end(); ++it) {
 		if (&track == &it->second) break;
 	}
-	// Check if the difficulty level is available
-	uint8_t basepitch = diffv[level].basepitch;
-	NoteMap const& nm = track.nm;
-	int fail = 0;
-	for (int fret = 0; fret < m_pads; ++fret) if (nm.find(basepitch + fret) == nm.end()) ++fail;
-	if (fail == m_pads) return false;
+	if (!hasDifficulty(track, level, m_pads)) return false;
 	if (check_only) return true;
 	Difficulty prevLevel = m_level;
 	m_level = level;
@@ -296,6 +292,29 @@ bool GuitarGraph::difficulty(Difficulty level, bool check_only) {
 	return true;
 }
 
+/// Check if the difficulty level is available
+bool GuitarGraph::hasDifficulty(InstrumentTrack const& track, Difficulty level, int pads) {
+	uint8_t basepitch = diffv[level].basepitch;
+	NoteMap const& nm = track.nm;
+	int fail = 0;
+	for (int fret = 0; fret < pads; ++fret) if (nm.find(basepitch + fret) == nm.end()) ++fail;
+	return fail != pads;
+}
+
+/// Build the chords of the levels that the constructor tries, for each track
+void GuitarGraph::prepare(Song const& song, SongTimelines& timelines) {
+	Difficulty const levels[] = { DIFFICULTY_EASY, DIFFICULTY_SUPAEASY, DIFFICULTY_MEDIUM, DIFFICULTY_AMAZING };
+	for (InstrumentTracks::const_iterator it = song.instrumentTracks.begin(); it != song.instrumentTracks.end(); ++it) {
+		if (it->first == TrackName::KEYBOARD) continue;  // Not played
+		for (std::size_t i = 0; i < sizeof(levels) / sizeof(*levels); ++i) {
+			if (!hasDifficulty(it->second, levels[i], 5)) continue;  // Five frets, as in the constructor
+			ChordTimeline& tl = timelines.chords[SongTimelines::Key(it->first, levels[i])];
+			buildChords(tl, song, it->second, levels[i], it->first == TrackName::DRUMS);
+			if (tl.chords.size() > 1) break;  // The level used (see difficulty())
+		}
+	}
+}
+
 
 /// Core engine
 void GuitarGraph::engine() {
@@ -1069,6 +1088,7 @@ void GuitarGraph::drawNote(int fret, Color color, float tBeg, float tEnd, float
 		y = yEnd + fretWid;
 		vertexPair(va, x, y, color, doanim ? tc(y + t) : 0.20f);
 		vertexPair(va, x, yEnd, color, doanim ? tc(yEnd + t) : 0.0f);
+		glutil::flushSprites();
 		glDisable(GL_DEPTH_TEST);
 		va.Draw();
 		glEnable(GL_DEPTH_TEST);
@@ -1179,10 +1199,10 @@ void GuitarGraph::drawBar(double time, float h) {
 	va.Draw();
 }
 
-bool GuitarGraph::updateTom(unsigned int tomTrack, unsigned int fretId) {
+bool GuitarGraph::updateTom(Chords& chords, NoteMap const& nm, unsigned int tomTrack, unsigned int fretId) {
 	// HiHat/Rack Tom 1 detection
-	NoteMap::const_iterator tomTrackIt = m_track_index->second->nm.find(tomTrack);
-	if (tomTrackIt != m_track_index->second->nm.end()) {
+	NoteMap::const_iterator tomTrackIt = nm.find(tomTrack);
+	if (tomTrackIt != nm.end()) {
 		if(tomTrack == 110) {
 			//std::cout << "HiHat/Rack Tom 1 detected" << std::endl;
 		} else if(tomTrack == 111) {
@@ -1194,7 +1214,7 @@ bool GuitarGraph::updateTom(unsigned int tomTrack, unsigned int fretId) {
 		}
 		for (Durations::const_iterator it = tomTrackIt->second.begin(); it != tomTrackIt->second.end(); ++it) {
 			//std::cout << " ++ @" << it->begin << "->@" << it->end << std::endl;
-			for (Chords::iterator it2 = m_chords.begin(); it2 != m_chords.end() ; ++it2) {
+			for (Chords::iterator it2 = chords.begin(); it2 != chords.end() ; ++it2) {
 				if(it2->begin >= it->begin && it2->begin < it->end && it2->fret[fretId]) {
 					//std::cout << " FOUND !!!!" << it2->begin << std::endl;
 					it2->fret_tom[fretId] = true;
@@ -1209,16 +1229,35 @@ bool GuitarGraph::updateTom(unsigned int tomTrack, unsigned int fretId) {
 	return false;
 }
 
-/// Create the Chord structures for the current track/difficulty level
+/// Use the Chord structures for the current track/difficulty level, prepared by SongPreload if possible
 void GuitarGraph::updateChords() {
-	m_chords.clear(); m_solos.clear(); m_drumfills.clear();
-	m_scoreFactor = 0;
-	NoteMap const& nm = m_track_index->second->nm;
+	ChordTimeline built;
+	ChordTimeline const* tl = NULL;
+	if (m_song.timelines) tl = SongTimelines::find(m_song.timelines->chords, m_track_index->first, m_level);
+	if (!tl) {
+		buildChords(built, m_song, *m_track_index->second, m_level, m_drums);
+		tl = &built;
+	}
+	m_chords = tl->chords;
+	m_chordIt = m_chords.begin();
+	m_solos = tl->solos;
+	m_drumfills = tl->drumfills;
+	m_dfIt = m_drumfills.end();
+	m_scoreFactor = tl->scoreFactor;
+	m_hasTomTrack = tl->hasTomTrack;
+}
+
+/// Create the Chord structures for a track/difficulty level
+void GuitarGraph::buildChords(ChordTimeline& tl, Song const& song, InstrumentTrack const& track, Difficulty level, bool drums) {
+	Chords& chords = tl.chords;
+	chords.clear(); tl.solos.clear(); tl.drumfills.clear();
+	double scoreFactor = 0;
+	NoteMap const& nm = track.nm;
 
 	Durations::size_type pos[5] = {}, size[5] = {};
 	Durations const* durations[5] = {};
 	for (int fret = 0; fret < 5; ++fret) {
-		int basepitch = diffv[m_level].basepitch;
+		int basepitch = diffv[level].basepitch;
 		NoteMap::const_iterator it = nm.find(basepitch + fret);
 		if (it == nm.end()) continue;
 		durations[fret] = &it->second;
@@ -1251,28 +1290,27 @@ void GuitarGraph::updateChords() {
 			tapfret = fret;
 			++c.polyphony;
 			++pos[fret];
-			m_scoreFactor += 50;
-			if (d.end - d.begin > 0.0) m_scoreFactor += 50.0 * (d.end - d.begin);
+			scoreFactor += 50;
+			if (d.end - d.begin > 0.0) scoreFactor += 50.0 * (d.end - d.begin);
 		}
 		// Check if the chord is tappable
-		if (!m_drums && c.polyphony == 1) {
+		if (!drums && c.polyphony == 1) {
 			c.tappable = true;
-			if (m_chords.empty() || m_chords.back().fret[tapfret]) c.tappable = false;
+			if (chords.empty() || chords.back().fret[tapfret]) c.tappable = false;
 			if (lastEnd + tapMaxDelay < t) c.tappable = false;
 		}
 		lastEnd = c.end;
-		m_chords.push_back(c);
+		chords.push_back(c);
 	}
-	m_chordIt = m_chords.begin();
 
-	m_hasTomTrack = false;
-	if(m_drums) {
+	tl.hasTomTrack = false;
+	if(drums) {
 		// HiHat/Rack Tom 1 detection
-		m_hasTomTrack = updateTom(110, input::YELLOW_TOM_BUTTON) || m_hasTomTrack;
+		tl.hasTomTrack = updateTom(chords, nm, 110, input::YELLOW_TOM_BUTTON) || tl.hasTomTrack;
 		// Ride Cymbal/Rack Tom 2 detection
-		m_hasTomTrack = updateTom(111, input::BLUE_TOM_BUTTON) || m_hasTomTrack;
+		tl.hasTomTrack = updateTom(chords, nm, 111, input::BLUE_TOM_BUTTON) || tl.hasTomTrack;
 		// Crash Cymbal/Floor Tom detection
-		m_hasTomTrack = updateTom(112, input::GREEN_TOM_BUTTON) || m_hasTomTrack;
+		tl.hasTomTrack = updateTom(chords, nm, 112, input::GREEN_TOM_BUTTON) || tl.hasTomTrack;
 	}
 
 	// Solos
@@ -1280,19 +1318,18 @@ void GuitarGraph::updateChords() {
 	if (solotrack != nm.end()) {
 		for (Durations::const_iterator it = solotrack->second.begin(); it != solotrack->second.end(); ++it) {
 			// Require at least 6s length in order to avoid starpower sections
-			if (it->end - it->begin >= 6.0) m_solos.push_back(*it);
+			if (it->end - it->begin >= 6.0) tl.solos.push_back(*it);
 		}
 	}
 	// Drum fills
 	NoteMap::const_iterator dfTrack = nm.find(124); // 124 = drum fills (actually 120-124, but one is enough)
 	if (dfTrack != nm.end()) {
-		m_drumfills = dfTrack->second;
+		tl.drumfills = dfTrack->second;
 		// Big Rock Ending scoring (single hold note)
-		if (!m_drums || m_song.hasBRE)
-			m_scoreFactor += 50.0 * (m_drumfills.back().end - m_drumfills.back().begin);
+		if (!drums || song.hasBRE)
+			scoreFactor += 50.0 * (tl.drumfills.back().end - tl.drumfills.back().begin);
 	}
-	m_dfIt = m_drumfills.end();
 
 	// Normalize maximum score factor
-	m_scoreFactor = 10000.0 / m_scoreFactor;
+	tl.scoreFactor = 10000.0 / scoreFactor;
 }
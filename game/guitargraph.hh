@@ -6,6 +6,7 @@
 #include "3dobject.hh"
 
 class Song;
+struct SongTimelines;
 
 struct Chord {
 	double begin, end;
@@ -42,6 +43,17 @@ static inline bool operator==(Chord const& a, Chord const& b) {
 	return std::equal(a.fret, a.fret + 5, b.fret);
 }
 
+/// Chords of one track at one difficulty level, with the timelines built along with them
+struct ChordTimeline {
+	typedef std::vector<Chord> Chords;
+	Chords chords;
+	std::vector<Duration> solos; ///< guitar solos
+	std::vector<Duration> drumfills; ///< drum fills
+	double scoreFactor; ///< normalization factor for the score
+	bool hasTomTrack; ///< true if the track has at least one tom track
+	ChordTimeline(): scoreFactor(), hasTomTrack() {}
+};
+
 /// handles drawing of notes and waves
 class GuitarGraph: public InstrumentGraph {
   public:
@@ -59,6 +71,8 @@ class GuitarGraph: public InstrumentGraph {
 	void changeTrack(int dir = 1);
 	void changeDifficulty(int dir = 1);
 	double getWhammy() const { return m_whammy; }
+	/// Build the timelines that new graphs start with (does not use OpenGL, any thread)
+	static void prepare(Song const& song, SongTimelines& timelines);
 
   private:
 	// refactoring methods
@@ -114,6 +128,7 @@ class GuitarGraph: public InstrumentGraph {
 	void setTrack(const std::string& track);
 	void difficultyAuto(bool tryKeepCurrent = false);
 	bool difficulty(Difficulty level, bool check_only = false);
+	static bool hasDifficulty(InstrumentTrack const& track, Difficulty level, int pads);
 	InstrumentTracksConstPtr m_instrumentTracks; /// tracks
 	InstrumentTracksConstPtr::const_iterator m_track_index;
 	unsigned m_holds[max_panels]; /// active hold notes
@@ -130,9 +145,10 @@ class GuitarGraph: public InstrumentGraph {
 	double neckWidth() const; ///< Get the currently effective neck width (0.5 or less)
 	// Chords & notes
 	void updateChords();
-	bool updateTom(unsigned int tomTrack, unsigned int fretId); // returns true if this tom track exists
+	static void buildChords(ChordTimeline& tl, Song const& song, InstrumentTrack const& track, Difficulty level, bool drums);
+	static bool updateTom(ChordTimeline::Chords& chords, NoteMap const& nm, unsigned int tomTrack, unsigned int fretId); // returns true if this tom track exists
 	double getNotesBeginTime() const { return m_chords.front().begin; }
-	typedef std::vector<Chord> Chords;
+	typedef ChordTimeline::Chords Chords;
 	Chords m_chords;
 	Chords::iterator m_chordIt;
 	typedef std::map<Duration const*, unsigned> NoteStatus; // Note in song to m_events[unsigned - 1] or 0 for not played
@@ -16,66 +16,97 @@ bool Hiscore::reachedHiscore(int score, int songid, std::string const& track) co
 
 	if (score < 2000) return false; // come on, did you even try to sing?
 
-	int counter = 0;
-	for (hiscore_t::const_iterator it = m_hiscore.begin(); it != m_hiscore.end(); ++it)
-	{
-		if (it->songid != songid) continue;
-		if (it->track != track) continue;
-		if (score > it->score) return true; // seems like you are in top 3!
-		else ++counter;
-		if (counter == 3) return false; // not in top 3 -> leave
-	}
-	return true; // nothing found for that song -> true
+	int t = trackId(track);
+	if (t == -1) return true; // no scores for that track yet (-1 would match all tracks of the song)
+	Scores const* scores = find(m_bySong, songid, t);
+	if (!scores || scores->size() < 3) return true; // not enough scores for that song -> true
+	Scores::const_iterator third = scores->begin();
+	std::advance(third, 2);
+	return score > (*third)->score; // in top 3?
 }
 
 void Hiscore::addHiscore(int score, int playerid, int songid, std::string const& track) {
-	HiscoreItem hi;
+	Entry e;
 	if (score < 0) throw HiscoreException("Score negative overflow");
 	if (score > 10000) throw HiscoreException("Score positive overflow");
-	hi.score = score;
+	e.score = score;
 
 	if (playerid < 0) throw HiscoreException("No player given");
-	hi.playerid = playerid;
+	e.playerid = playerid;
 
 	if (songid < 0) throw HiscoreException("No song given");
-	hi.songid = songid;
+	e.songid = songid;
 
 	if (track.empty()) throw HiscoreException("No track given");
-	hi.track = track;
+	e.track = trackId(track);
+	if (e.track == -1) {
+		e.track = m_trackNames.size();
+		m_trackNames.push_back(track);
+		m_trackIds[track] = e.track;
+		m_byTrack.push_back(Scores());
+	}
 
-	m_hiscore.insert(hi);
+	m_entries.push_back(e);
+	Entry const* p = &m_entries.back();
+	m_all.insert(p);
+	m_bySong[Key(songid, -1)].insert(p);
+	m_bySong[Key(songid, e.track)].insert(p);
+	m_byPlayer[Key(playerid, -1)].insert(p);
+	m_byPlayer[Key(playerid, e.track)].insert(p);
+	m_byTrack[e.track].insert(p);
 }
 
 Hiscore::HiscoreVector Hiscore::queryHiscore(int max, int playerid, int songid, std::string const& track) const {
 	HiscoreVector hv;
-	for (hiscore_t::const_iterator it = m_hiscore.begin(); it != m_hiscore.end(); ++it) {
-		if (playerid != -1)
-		{
-			if (playerid != it->playerid) continue;
-		}
-		if (songid != -1)
-		{
-			if (songid != it->songid) continue;
-		}
-		if (!track.empty())
+	int t = -1;
+	if (!track.empty())
+	{
+		t = trackId(track);
+		if (t == -1) return hv; // no scores for such track
+	}
+	// Use the most specific index, only the player may need to be checked separately
+	Scores const* scores;
+	if (songid != -1) scores = find(m_bySong, songid, t);
+	else if (playerid != -1) scores = find(m_byPlayer, playerid, t);
+	else if (t != -1) scores = &m_byTrack[t];
+	else scores = &m_all;
+	if (!scores) return hv;
+	for (Scores::const_iterator it = scores->begin(); it != scores->end(); ++it) {
+		if (songid != -1 && playerid != -1)
 		{
-			if (track != it->track) continue;
+			if (playerid != (*it)->playerid) continue;
 		}
 		if (max != -1)
 		{
 			if (max == 0) break;
 			--max;
 		}
-		hv.push_back(*it);
+		hv.push_back(item(**it));
 	}
 	return hv;
 }
 
 bool Hiscore::hasHiscore(int songid) const {
-	for (hiscore_t::const_iterator it = m_hiscore.begin(); it != m_hiscore.end(); ++it) {
-		if(songid == it->songid) return true;
-	}
-	return false;
+	return find(m_bySong, songid, -1);
+}
+
+int Hiscore::trackId(std::string const& track) const {
+	boost::unordered_map<std::string, int>::const_iterator it = m_trackIds.find(track);
+	return it == m_trackIds.end() ? -1 : it->second;
+}
+
+Hiscore::Scores const* Hiscore::find(Index const& index, int id, int track) {
+	Index::const_iterator it = index.find(Key(id, track));
+	return it == index.end() ? NULL : &it->second;
+}
+
+HiscoreItem Hiscore::item(Entry const& e) const {
+	HiscoreItem hi;
+	hi.score = e.score;
+	hi.playerid = e.playerid;
+	hi.songid = e.songid;
+	hi.track = m_trackNames[e.track];
+	return hi;
 }
 
 void Hiscore::load(xmlpp::NodeSet const& n) {
@@ -104,11 +135,11 @@ void Hiscore::load(xmlpp::NodeSet const& n) {
 }
 
 void Hiscore::save(xmlpp::Element *hiscores) {
-	for (hiscore_t::const_iterator it = m_hiscore.begin(); it != m_hiscore.end(); ++it) {
+	for (Scores::const_iterator it = m_all.begin(); it != m_all.end(); ++it) {
 		xmlpp::Element* hiscore = hiscores->add_child("hiscore");
-		hiscore->set_attribute("playerid", boost::lexical_cast<std::string>(it->playerid));
-		hiscore->set_attribute("songid", boost::lexical_cast<std::string>(it->songid));
-		hiscore->set_attribute("track", it->track);
-		hiscore->add_child_text(boost::lexical_cast<std::string>(it->score));
+		hiscore->set_attribute("playerid", boost::lexical_cast<std::string>((*it)->playerid));
+		hiscore->set_attribute("songid", boost::lexical_cast<std::string>((*it)->songid));
+		hiscore->set_attribute("track", m_trackNames[(*it)->track]);
+		hiscore->add_child_text(boost::lexical_cast<std::string>((*it)->score));
 	}
 }
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <deque>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 #include <stdexcept>
 
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
 namespace xmlpp { class Node; class Element; typedef std::vector<Node*>NodeSet; }
 
 /**Exception which will be thrown when loading or
@@ -32,6 +38,11 @@ struct HiscoreItem {
 	}
 };
 
+/**All hiscores, indexed by song, player and track.
+
+  Every index keeps its scores sorted (highest first), so that a
+  top-N query only visits the N items it returns. Track names are
+  interned as small integers.*/
 class Hiscore
 {
   public:
@@ -73,8 +84,38 @@ class Hiscore
 	 */
 	HiscoreVector queryHiscore(int max = -1, int playerid = -1, int songid = -1, std::string const& track = "") const;
 	bool hasHiscore(int songid) const;
+	/// number of hiscores added (loaded or new), for journaling
+	std::size_t addedCount() const { return m_entries.size(); }
+	/// hiscores in the order they were added
+	HiscoreItem added(std::size_t pos) const { return item(m_entries[pos]); }
   private:
-	typedef std::multiset<HiscoreItem>hiscore_t;
-
-	hiscore_t m_hiscore;
+	/// A stored hiscore (like HiscoreItem but with the track interned)
+	struct Entry {
+		int score;
+		int playerid;
+		int songid;
+		int track;
+	};
+	/// Sorts by score, highest first (equal scores stay in insertion order)
+	struct ScoreGreater {
+		bool operator()(Entry const* a, Entry const* b) const { return b->score < a->score; }
+	};
+	typedef std::multiset<Entry const*, ScoreGreater> Scores;
+	/// Song or player id and track id (-1 for all tracks)
+	typedef std::pair<int, int> Key;
+	typedef boost::unordered_map<Key, Scores, boost::hash<Key> > Index;
+
+	/// Get the id of a track name, -1 if it has none
+	int trackId(std::string const& track) const;
+	/// Get the scores by song or player for a track, NULL if there are none
+	static Scores const* find(Index const& index, int id, int track);
+	HiscoreItem item(Entry const& e) const;
+
+	std::deque<Entry> m_entries; ///< Storage for all items (never moved)
+	Scores m_all;
+	Index m_bySong;
+	Index m_byPlayer;
+	std::vector<Scores> m_byTrack; ///< Indexed by track id
+	std::vector<std::string> m_trackNames; ///< Track names by id
+	boost::unordered_map<std::string, int> m_trackIds;
 };
@@ -100,7 +100,7 @@ namespace {
 
 static inline void loadSVG(Bitmap& bitmap, std::string const& filename) {
 	double factor = config["graphic/svg_lod"].f();
-	// Try to load a cached PNG instead
+	// Try to load a cached bitmap instead
 	if (cache::loadSVG(bitmap, filename, factor)) return;
 	// Open the SVG file in librsvg
 	g_type_init();
@@ -123,10 +123,9 @@ static inline void loadSVG(Bitmap& bitmap, std::string const& filename) {
 	boost::shared_ptr<cairo_t> dc(cairo_create(surface.get()), cairo_destroy);
 	cairo_scale(dc.get(), factor, factor);
 	rsvg_handle_render_cairo(svgHandle.get(), dc.get());
+	cairo_surface_flush(surface.get());
 	// Write to cache so that it can be loaded faster the next time
-	fs::path const cache_filename = cache::constructSVGCacheFileName(filename, factor);
-	fs::create_directories(cache_filename.parent_path());
-	cairo_surface_write_to_png(surface.get(), cache_filename.string().c_str());
+	cache::saveRaw(bitmap, cache::constructSVGCacheFileName(filename, factor, ".raw"), filename, factor);
 }
 
 static inline void loadPNG(Bitmap& bitmap, std::string const& filename) {
@@ -176,7 +175,8 @@ static void my_jpeg_error_exit (j_common_ptr cinfo) {
 	longjmp(myerr->setjmp_buffer, 1);
 }
 
-static inline void loadJPEG(Bitmap& bitmap, std::string const& filename) {
+/// Load a JPEG, optionally letting libjpeg scale it down (in DCT) to no less than minSize pixels on the longer side
+static inline void loadJPEG(Bitmap& bitmap, std::string const& filename, unsigned minSize = 0) {
 	bitmap.fmt = pix::RGB;
 	struct my_jpeg_error_mgr jerr;
 	FILE* infile = fopen(filename.c_str(), "rb");
@@ -192,6 +192,13 @@ static inline void loadJPEG(Bitmap& bitmap, std::string const& filename) {
 	jpeg_create_decompress(&cinfo);
 	jpeg_stdio_src(&cinfo, infile);
 	if( jpeg_read_header(&cinfo, true) != JPEG_HEADER_OK) throw std::runtime_error("Cannot read header of " + filename);
+	if (minSize) {
+		unsigned size = std::max(cinfo.image_width, cinfo.image_height);
+		unsigned denom = 1;
+		while (denom < 8 && size / (2 * denom) >= minSize) denom *= 2;
+		cinfo.scale_num = 1;
+		cinfo.scale_denom = denom;
+	}
 	jpeg_start_decompress(&cinfo);
 	bitmap.resize(cinfo.output_width, cinfo.output_height);
 	unsigned stride = (bitmap.width * 3 + 3) & ~3;  // Number of bytes per row (word-aligned)
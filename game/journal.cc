@@ -0,0 +1,124 @@
+#include "journal.hh"
+
+#include "mappedfile.hh"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+	const char* const MAGIC = "performous-journal";
+	const char* const VERSION = "1";
+
+	std::string unescape(char const* begin, char const* end) {
+		std::string ret;
+		ret.reserve(end - begin);
+		for (char const* p = begin; p != end; ++p) {
+			if (*p != '\\' || p + 1 == end) { ret += *p; continue; }
+			switch (*++p) {
+			  case 't': ret += '\t'; break;
+			  case 'n': ret += '\n'; break;
+			  default: ret += *p; break;
+			}
+		}
+		return ret;
+	}
+}
+
+void Journal::read(Handler const& handler) const {
+	MappedFile file(m_filename.string());
+	Record record;
+	bool first = true;
+	for (char const* line = file.begin(); line != file.end();) {
+		char const* eol = std::find(line, file.end(), '\n');
+		if (eol == file.end()) break;  // Torn write, the commit never completed
+		record.clear();
+		for (char const* field = line;;) {
+			char const* end = field;
+			while (end != eol && *end != '\t') end += (*end == '\\' && end + 1 != eol ? 2 : 1);
+			record.push_back(unescape(field, end));
+			if (end == eol) break;
+			field = end + 1;
+		}
+		line = eol + 1;
+		if (first) {
+			if (record.size() != 2 || record[0] != MAGIC) throw std::runtime_error("Not a journal file");
+			if (record[1] != VERSION) throw std::runtime_error("Unsupported journal version " + record[1]);
+			first = false;
+			continue;
+		}
+		handler(record);
+	}
+	if (first) throw std::runtime_error("Journal header missing");
+}
+
+void Journal::commit() {
+	if (m_pending.empty()) return;
+	std::string data = m_pending;
+	if (!exists()) data = header() + data;
+	else {
+		// Terminate a torn last line so that it does not swallow the first new record
+		std::ifstream f(m_filename.string().c_str(), std::ios::binary);
+		char last = '\n';
+		if (f.seekg(-1, std::ios::end)) f.get(last);
+		if (last != '\n') data = '\n' + data;
+	}
+	writeFile(m_filename, data, true);
+	m_pending.clear();
+}
+
+void Journal::rewrite(std::vector<Record> const& records) {
+	std::string data = header();
+	for (std::vector<Record>::const_iterator it = records.begin(); it != records.end(); ++it) write(data, *it);
+	data += m_pending;
+	fs::path tmp = m_filename;
+	tmp.replace_extension(".tmp");
+	writeFile(tmp, data, false);
+	fs::rename(tmp, m_filename);
+	m_pending.clear();
+}
+
+void Journal::write(std::string& out, Record const& record) {
+	for (Record::const_iterator it = record.begin(); it != record.end(); ++it) {
+		if (it != record.begin()) out += '\t';
+		for (std::string::const_iterator c = it->begin(); c != it->end(); ++c) {
+			switch (*c) {
+			  case '\t': out += "\\t"; break;
+			  case '\n': out += "\\n"; break;
+			  case '\\': out += "\\\\"; break;
+			  default: out += *c; break;
+			}
+		}
+	}
+	out += '\n';
+}
+
+void Journal::writeFile(fs::path const& filename, std::string const& data, bool append) {
+	if (!filename.parent_path().empty()) fs::create_directories(filename.parent_path());
+	std::FILE* f = std::fopen(filename.string().c_str(), append ? "ab" : "wb");
+	if (!f) throw std::runtime_error("Cannot open " + filename.string() + " for writing");
+	bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size() && std::fflush(f) == 0;
+#ifdef _WIN32
+	ok = ok && _commit(_fileno(f)) == 0;
+#else
+	ok = ok && fsync(fileno(f)) == 0;
+#endif
+	if (std::fclose(f) != 0) ok = false;
+	if (!ok) throw std::runtime_error("Error writing " + filename.string());
+}
+
+std::string Journal::header() const {
+	std::string ret;
+	Record h;
+	h.push_back(MAGIC);
+	h.push_back(VERSION);
+	write(ret, h);
+	return ret;
+}
+
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "fs.hh"
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+/**
+* @short Append-only file of records, each commit flushed to disk.
+* A record is a line of tab separated fields (with tabs, newlines and backslashes escaped).
+* The file starts with a header record. A torn last line (crash while writing) is ignored
+* when reading, so a crash can lose at most the commit in progress.
+**/
+class Journal: boost::noncopyable {
+  public:
+	typedef std::vector<std::string> Record;
+	typedef boost::function<void (Record const&)> Handler;
+	explicit Journal(fs::path const& filename): m_filename(filename) {}
+	fs::path const& file() const { return m_filename; }
+	bool exists() const { return fs::exists(m_filename); }
+	/// Call handler for each record in the order they were written, throws std::runtime_error on errors
+	void read(Handler const& handler) const;
+	/// Queue a record for the next commit
+	void append(Record const& record) { write(m_pending, record); }
+	/// Write the queued records at the end of the file and flush them to disk
+	void commit();
+	/// Replace the whole file with the given records (atomically, through a temporary file)
+	void rewrite(std::vector<Record> const& records);
+  private:
+	static void write(std::string& out, Record const& record);
+	static void writeFile(fs::path const& filename, std::string const& data, bool append);
+	std::string header() const;
+	fs::path m_filename;
+	std::string m_pending; ///< Encoded records not yet committed
+};
+
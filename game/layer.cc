@@ -0,0 +1,41 @@
+#include "layer.hh"
+
+#include "configuration.hh"
+#include "glutil.hh"
+
+Layer::Layer(): m_width(), m_height(), m_generation(), m_valid() {}
+
+Layer::~Layer() {}
+
+void Layer::draw(DrawFunc const& drawFunc, std::string const& key) {
+	if (config["graphic/stereo3d"].b()) { drawFunc(); return; }
+	unsigned w = screenW(), h = screenH();
+	if (!m_fbo || w != m_width || h != m_height) {
+		// sRGB storage avoids banding, as the contents are stored in linear color space
+		m_fbo.reset(new FBO(w, h, GL_EXT_framebuffer_sRGB ? GL_SRGB_ALPHA : GL_RGBA));
+		m_width = w;
+		m_height = h;
+		m_valid = false;
+	}
+	if (!m_valid || m_generation != surfaceGeneration() || m_key != key) {
+		glutil::GLErrorChecker glerror("Layer::draw");
+		GLint viewport[4];
+		GLfloat clearColor[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+		{
+			UseFBO fbo(*m_fbo);
+			glViewport(0, 0, w, h);
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			drawFunc();
+		}
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+		m_generation = surfaceGeneration();
+		m_key = key;
+		m_valid = true;
+	}
+	// The contents are premultiplied, so the usual blending composites them correctly
+	m_fbo->getTexture().draw(Dimensions(double(w) / h).fixedWidth(1.0), TexCoords(0.0, h, w, 0.0));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "fbo.hh"
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <string>
+
+/**
+* @short Static part of a screen, rendered once into an FBO and then drawn as a single quad.
+* The contents are rendered again when the window size changes, when background loaded images
+* get applied (see surfaceGeneration), when the content key changes or after invalidate().
+* Layers must be drawn with the default transforms (any transforms go inside the draw function).
+* In stereo 3D mode the contents are drawn directly, as they differ for each eye.
+**/
+class Layer: boost::noncopyable {
+  public:
+	typedef boost::function<void ()> DrawFunc;
+	Layer();
+	~Layer();
+	/// Draw the layer, calling drawFunc first if the contents need to be rendered
+	/// @param key identifies the contents (e.g. the song shown), a different key re-renders
+	void draw(DrawFunc const& drawFunc, std::string const& key = std::string());
+	/// Render the contents again on the next draw (e.g. after a theme reload)
+	void invalidate() { m_valid = false; }
+  private:
+	boost::scoped_ptr<FBO> m_fbo;
+	unsigned m_width, m_height;
+	unsigned long m_generation;
+	std::string m_key;
+	bool m_valid;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+#include <stdexcept>
+#include <string>
+
+/** @short Read-only memory mapping of a whole file (empty files map to an empty range) **/
+class MappedFile {
+  public:
+	MappedFile() {}
+	explicit MappedFile(std::string const& filename) { open(filename); }
+	/// Map a file, throws std::runtime_error on failure
+	void open(std::string const& filename) {
+		namespace bip = boost::interprocess;
+		close();
+		try {
+			if (boost::filesystem::file_size(filename) == 0) return;
+			bip::file_mapping file(filename.c_str(), bip::read_only);
+			bip::mapped_region region(file, bip::read_only);
+			m_region.swap(region);
+		} catch (std::exception& e) {
+			throw std::runtime_error("Cannot map " + filename + ": " + e.what());
+		}
+	}
+	void close() { boost::interprocess::mapped_region empty; m_region.swap(empty); }
+	char const* data() const { return static_cast<char const*>(m_region.get_address()); }
+	size_t size() const { return m_region.get_size(); }
+	char const* begin() const { return data(); }
+	char const* end() const { return data() + size(); }
+	bool empty() const { return size() == 0; }
+  private:
+	MappedFile(MappedFile const&);
+	MappedFile& operator=(MappedFile const&);
+	boost::interprocess::mapped_region m_region;
+};
+
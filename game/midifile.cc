@@ -1,11 +1,10 @@
 #include "midifile.hh"
 
+#include "mappedfile.hh"
 #include <algorithm>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
-#include <sstream>
 #include <string>
 
 #define MIDI_DEBUG_LEVEL 0
@@ -13,6 +12,7 @@
 
 /**
  * @short The MidiStream class reads midifile for MidiFileParser.
+ * The file is mapped into memory and read through bounds-checked RIFF chunk cursors.
  */
 
 class MidiStream {
@@ -24,18 +24,12 @@ class MidiStream {
 	 *
 	 * @param file MidiFile to be read
 	 */
-	MidiStream(std::string const& file) {
-		std::ifstream ifs(file.c_str(), std::ios::binary);
+	MidiStream(std::string const& file): m_file(file), m_pos() {
 #if MIDI_DEBUG_LEVEL > 1
 		std::cout << "Opening file: " << file << std::endl;
 #endif
-		f << ifs.rdbuf();
-		f.exceptions(std::ios::failbit);
 	}
 
-	/// read bytes
-	std::string read_bytes(size_t bytes);
-
 	class Riff {
 	  public:
 		MidiStream& ms;
@@ -46,43 +40,52 @@ class MidiStream {
 		Riff(MidiStream& ms);
 		~Riff();
 		bool has_more_data() const { return offset < size; }
-		uint8_t read_uint8() { consume(1); return ms.f.get(); }
-		uint16_t read_uint16() { consume(2); return ms.read_uint16(); }
-		uint32_t read_uint32() { consume(4); return ms.read_uint32(); }
+		uint8_t read_uint8() { return *consume(1); }
+		uint16_t read_uint16() { uint16_t value; return read(value); }
+		uint32_t read_uint32() { uint32_t value; return read(value); }
 		uint32_t read_varlen();
 		template <typename T> T read(T& value) {
-			consume(sizeof(T));
+			unsigned char const* p = consume(sizeof(T));
 			value = 0;
-			for (int i = sizeof(T) - 1; i >= 0; --i) value |= ms.f.get() << (8 * i);
+			for (size_t i = 0; i < sizeof(T); ++i) value = value << 8 | p[i];
 			return value;
 		}
-		std::string read_bytes(size_t size) { consume(size); return ms.read_bytes(size); }
-		void ignore(size_t size) { consume(size); ms.f.ignore(size); }
+		std::string read_bytes(size_t size) { return std::string(reinterpret_cast<char const*>(consume(size)), size); }
+		void ignore(size_t size) { consume(size); }
 		void seek_back(size_t offset = 1);
 	  private:
-		void consume(size_t bytes);
+		unsigned char const* consume(size_t bytes);
 	};
 
 private:
 
-	std::stringstream f;
-	uint16_t read_uint16() { return f.get() << 8 | f.get(); }
-	uint32_t read_uint32() { return f.get() << 24 | f.get() << 16 | f.get() << 8 | f.get(); }
-
+	/// Read from the current position at file level (outside of chunks)
+	unsigned char const* read(size_t bytes) {
+		if (m_file.size() - m_pos < bytes) throw std::runtime_error("Unexpected end of MIDI file");
+		unsigned char const* p = reinterpret_cast<unsigned char const*>(m_file.data()) + m_pos;
+		m_pos += bytes;
+		return p;
+	}
+	MappedFile m_file;
+	size_t m_pos; ///< Current position at file level
 };
 
 namespace { bool is_not_alpha(char c) { return (c < 'A' || c > 'Z') && (c < 'a' || c > 'z'); } }
 
-MidiStream::Riff::Riff(MidiStream& ms): ms(ms), name(ms.read_bytes(4)), size(ms.read_uint32()), offset(0) {
+MidiStream::Riff::Riff(MidiStream& ms): ms(ms), name(reinterpret_cast<char const*>(ms.read(4)), 4), offset(0) {
 	if (std::find_if(name.begin(), name.end(), is_not_alpha) != name.end()) throw std::runtime_error("Invalid RIFF chunk name");
-	pos = ms.f.tellg();
+	unsigned char const* p = ms.read(4);
+	size = uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	pos = ms.m_pos;
+	// A chunk claiming more data than there is can still be read up to the end of the file
+	size = std::min(size, ms.m_file.size() - pos);
 }
 
 MidiStream::Riff::~Riff() {
 #if MIDI_DEBUG_LEVEL > 0
 	if (has_more_data()) std::clog << "MidiStream/warning: Only " << offset << " of " << size << " bytes read of RIFF chunk " << name << std::endl;
 #endif
-	ms.f.seekg(pos + size);
+	ms.m_pos = pos + size;
 }
 
 uint32_t MidiStream::Riff::read_varlen() {
@@ -91,34 +94,27 @@ uint32_t MidiStream::Riff::read_varlen() {
 	unsigned char c;
 	do {
 		if (++a > 4) throw std::runtime_error("Too long varlen sequence");
-		consume(1);
-		c = ms.f.get();
+		c = *consume(1);
 		value = (value << 7) | (c & 0x7F);
 	} while (c & 0x80);
 	return value;
 }
 
-std::string MidiStream::read_bytes(size_t bytes) {
-	std::string data;
-	for(size_t i=0; i < bytes; ++i) data += f.get();
-	return data;
-}
-
-void MidiStream::Riff::consume(size_t bytes) {
+unsigned char const* MidiStream::Riff::consume(size_t bytes) {
 	if (size - offset < bytes) throw std::runtime_error("Read past the end of RIFF chunk " + name);
-	ms.f.seekg(pos + offset);
+	unsigned char const* p = reinterpret_cast<unsigned char const*>(ms.m_file.data()) + pos + offset;
 	offset += bytes;
+	return p;
 }
 
 void MidiStream::Riff::seek_back(size_t o) {
 	if (offset < o) throw std::runtime_error("Seek past the beginning of RIFF chunk " + name);
 	offset -= o;
-	ms.f.seekg(pos + offset);
 }
 
 
 MidiFileParser::MidiFileParser(std::string name):
-  format(0), division(0), ts_last(0)
+  format(0), division(0), ts_last(0), m_tempoIdx(0)
 {
 	MidiStream stream(name.c_str());
 	size_t ntracks = parse_header(stream);
@@ -270,7 +266,12 @@ void MidiFileParser::add_tempo_change(uint32_t miditime, uint32_t tempo) {
 #if MIDI_DEBUG_LEVEL > 2
 	std::cout << "Tempo change at miditime=" << miditime << ":  " << tempo << " us/QN  " << 6e7 / tempo << " BPM" << std::endl;
 #endif
-	tempochanges.push_back(TempoChange(miditime, tempo));
+	uint64_t us = 0;
+	if (!tempochanges.empty()) {
+		TempoChange const& prev = tempochanges.back();
+		us = prev.us + static_cast<uint64_t>(prev.value) * (miditime - prev.miditime);
+	}
+	tempochanges.push_back(TempoChange(miditime, tempo, us));
 }
 
 void MidiFileParser::cout_midi_event(uint8_t t, uint8_t arg1, uint8_t arg2, uint32_t miditime) {
@@ -290,14 +291,18 @@ void MidiFileParser::cout_midi_event(uint8_t t, uint8_t arg1, uint8_t arg2, uint
 
 uint64_t MidiFileParser::get_us(uint32_t miditime) {
 	if (tempochanges.empty()) throw std::runtime_error("Unable to calculate note duration without tempo");
-	uint64_t time = 0;
-	std::vector<TempoChange>::iterator i = tempochanges.begin();
-	// TODO: cache previous
-	for (; i + 1 != tempochanges.end() && (i + 1)->miditime < miditime; ++i) {
-		time += static_cast<uint64_t>(i->value) * ((i + 1)->miditime - i->miditime);
+	// Find the tempo in effect, usually the same as on the previous call or the next one
+	size_t i = m_tempoIdx;
+	if (i >= tempochanges.size() || tempochanges[i].miditime > miditime) i = 0;
+	if (i + 1 < tempochanges.size() && tempochanges[i + 1].miditime <= miditime) {
+		++i;
+		if (i + 1 < tempochanges.size() && tempochanges[i + 1].miditime <= miditime) {
+			i = std::upper_bound(tempochanges.begin() + i, tempochanges.end(), miditime, TempoChange::ltMiditime) - tempochanges.begin() - 1;
+		}
 	}
-	time += static_cast<uint64_t>(i->value) * (miditime - i->miditime);
-	return time / division;
+	m_tempoIdx = i;
+	TempoChange const& tc = tempochanges[i];
+	return (tc.us + static_cast<uint64_t>(tc.value) * (miditime - tc.miditime)) / division;
 }
 
 void MidiFileParser::process_midi_event(Track& track, uint8_t t, uint8_t arg1, uint8_t arg2, uint32_t miditime) {
@@ -47,8 +47,10 @@ class MidiFileParser{
 
 	struct TempoChange {
 		uint32_t miditime;
-		uint32_t value;
-		TempoChange(uint32_t miditime, uint32_t value): miditime(miditime), value(value) {}
+		uint32_t value; ///< Microseconds per quarter note
+		uint64_t us; ///< Time of the change in microseconds multiplied by division
+		TempoChange(uint32_t miditime, uint32_t value, uint64_t us): miditime(miditime), value(value), us(us) {}
+		static bool ltMiditime(uint32_t miditime, TempoChange const& tc) { return miditime < tc.miditime; }
 	};
 	typedef std::vector<TempoChange> TempoChanges;
 	TempoChanges tempochanges;
@@ -99,5 +101,6 @@ class MidiFileParser{
 	uint32_t ts_last;
   private:
 	std::string m_lyric;
+	size_t m_tempoIdx; ///< Tempo change used by the previous get_us call
 };
 
@@ -2,10 +2,11 @@
 
 #include "configuration.hh"
 #include "engine.hh"
+#include <algorithm>
 
 Dimensions dimensions; // Make a public member variable
 
-NoteGraph::NoteGraph(VocalTrack const& vocal):
+NoteGraph::NoteGraph(VocalTrack& vocal):
   m_vocal(vocal),
   m_notelines(getThemePath("notelines.svg")), m_wave(getThemePath("wave.png")),
   m_star(getThemePath("star.svg")), m_star_hl(getThemePath("star_glow.svg")),
@@ -17,13 +18,12 @@ NoteGraph::NoteGraph(VocalTrack const& vocal):
 	dimensions.stretch(1.0, 0.5); // Initial dimensions, probably overridden from somewhere
 	m_nlTop.setTarget(m_vocal.noteMax, true);
 	m_nlBottom.setTarget(m_vocal.noteMin, true);
-	for (Notes::const_iterator it = m_vocal.notes.begin(); it != m_vocal.notes.end(); ++it)
-		it->stars.clear(); // Reset stars
+	vocal.states.reset(vocal.notes.size()); // Reset stars and powers
 	reset();
 }
 
 void NoteGraph::reset() {
-	m_songit = m_vocal.notes.begin();
+	m_songit = 0;
 }
 
 namespace {
@@ -68,7 +68,8 @@ void NoteGraph::draw(double time, Database const& database, Position position) {
 	if (time < m_time) reset();
 	m_time = time;
 	// Update m_songit (which note to start the rendering from)
-	while (m_songit != m_vocal.notes.end() && (m_songit->type == Note::SLEEP || m_songit->end < time - (baseLine + 0.5) / pixUnit)) ++m_songit;
+	NoteTimeline const& notes = m_vocal.timeline;
+	while (m_songit < notes.size() && (notes.sleep(m_songit) || notes.end[m_songit] < time - (baseLine + 0.5) / pixUnit)) ++m_songit;
 
 	// Automatically zooming notelines
 	{
@@ -76,13 +77,14 @@ void NoteGraph::draw(double time, Database const& database, Position position) {
 		int high = m_vocal.noteMin;
 		int low2 = m_vocal.noteMax;
 		int high2 = m_vocal.noteMin;
-		for (Notes::const_iterator it = m_songit; it != m_vocal.notes.end() && it->begin < time + 15.0; ++it) {
-			if (it->type == Note::SLEEP) continue;
-			if (it->note < low) low = it->note;
-			if (it->note > high) high = it->note;
-			if (it->begin > time + 8.0) continue;
-			if (it->note < low2) low2 = it->note;
-			if (it->note > high2) high2 = it->note;
+		for (std::size_t i = m_songit; i < notes.size() && notes.begin[i] < time + 15.0; ++i) {
+			if (notes.sleep(i)) continue;
+			int note = notes.note[i];
+			if (note < low) low = note;
+			if (note > high) high = note;
+			if (notes.begin[i] > time + 8.0) continue;
+			if (note < low2) low2 = note;
+			if (note > high2) high2 = note;
 		}
 		if (low2 <= high2) {
 			m_nlTop.setRange(high2, high);
@@ -113,7 +115,7 @@ void NoteGraph::draw(double time, Database const& database, Position position) {
 	m_baseX = baseLine - m_time * pixUnit + dimensions.xc();  // FIXME: Moving in X direction requires additional love (is b0rked now, keep it centered at zero)
 
 	// Fading notelines handing
-	if (m_songit == m_vocal.notes.end() || m_songit->begin > m_time + 3.0) m_notealpha -= 0.02f;
+	if (m_songit == notes.size() || notes.begin[m_songit] > m_time + 3.0) m_notealpha -= 0.02f;
 	else if (m_notealpha < 1.0f) m_notealpha += 0.02f;
 	if (m_notealpha <= 0.0f) { m_notealpha = 0.0f; return; }
 
@@ -123,26 +125,28 @@ void NoteGraph::draw(double time, Database const& database, Position position) {
 	if (config["game/pitch"].b()) drawWaves(database);
 
 	// Draw a star for well sung notes
-	for (Notes::const_iterator it = m_songit; it != m_vocal.notes.end() && it->begin < m_time - (baseLine - 0.5) / pixUnit; ++it) {
-		float player_star_offset = 0;
-		for (std::vector<Color>::const_iterator it_col = it->stars.begin(); it_col != it->stars.end(); ++it_col) {
-			double x = m_baseX + it->begin * pixUnit + m_noteUnit; // left x coordinate: begin minus border (side borders -noteUnit wide)
-			double w = (it->end - it->begin) * pixUnit - m_noteUnit * 2.0; // width: including borders on both sides
-			float hh = -m_noteUnit;
-			float centery = m_baseY + (it->note + 0.4) * m_noteUnit; // Star is 0.4 notes higher than current note
-			float centerx = x + w - (player_star_offset + 1.2) * hh; // Star is 1.2 units from end
-			float rot = fmod(time * 5.0, 2.0 * M_PI); // They rotate!
-			bool smallerNoteGraph = ((position == NoteGraph::TOP) || (position == NoteGraph::BOTTOM));
-			float zoom = (std::abs((rot-180) / 360.0f) * 0.8f + 0.6f) * (smallerNoteGraph ? 2.3 : 2.0) * hh;
-			using namespace glmath;
-			Transform trans(translate(vec3(centerx, centery, 0.0f)) * rotate(rot, vec3(0.0f, 0.0f, 1.0f)));
-			{
-				ColorTrans c(Color(it_col->r, it_col->g, it_col->b, it_col->a));
-				m_star_hl.draw(Dimensions().stretch(zoom*1.2, zoom*1.2).center().middle(), TexCoords());
-			}
-			m_star.draw(Dimensions().stretch(zoom, zoom).center().middle(), TexCoords());
-			player_star_offset += 0.8;
+	NoteStates::Stars const& stars = m_vocal.states.stars;
+	float player_star_offset = 0;
+	for (NoteStates::Stars::const_iterator it_col = std::lower_bound(stars.begin(), stars.end(), m_songit, NoteStates::Star::ltNote); it_col != stars.end(); ++it_col) {
+		std::size_t const i = it_col->note;
+		if (notes.begin[i] >= m_time - (baseLine - 0.5) / pixUnit) break;
+		if (it_col != stars.begin() && (it_col - 1)->note != it_col->note) player_star_offset = 0;
+		double x = m_baseX + notes.begin[i] * pixUnit + m_noteUnit; // left x coordinate: begin minus border (side borders -noteUnit wide)
+		double w = (notes.end[i] - notes.begin[i]) * pixUnit - m_noteUnit * 2.0; // width: including borders on both sides
+		float hh = -m_noteUnit;
+		float centery = m_baseY + (notes.note[i] + 0.4) * m_noteUnit; // Star is 0.4 notes higher than current note
+		float centerx = x + w - (player_star_offset + 1.2) * hh; // Star is 1.2 units from end
+		float rot = fmod(time * 5.0, 2.0 * M_PI); // They rotate!
+		bool smallerNoteGraph = ((position == NoteGraph::TOP) || (position == NoteGraph::BOTTOM));
+		float zoom = (std::abs((rot-180) / 360.0f) * 0.8f + 0.6f) * (smallerNoteGraph ? 2.3 : 2.0) * hh;
+		using namespace glmath;
+		Transform trans(translate(vec3(centerx, centery, 0.0f)) * rotate(rot, vec3(0.0f, 0.0f, 1.0f)));
+		{
+			ColorTrans c(it_col->color);
+			m_star_hl.draw(Dimensions().stretch(zoom*1.2, zoom*1.2).center().middle(), TexCoords());
 		}
+		m_star.draw(Dimensions().stretch(zoom, zoom).center().middle(), TexCoords());
+		player_star_offset += 0.8;
 	}
 }
 
@@ -151,18 +155,20 @@ void NoteGraph::drawNotes() {
 	m_notelines.draw(Dimensions().stretch(dimensions.w(), (m_max - m_min - 13) * m_noteUnit).middle(dimensions.xc()).center(dimensions.yc()), TexCoords(0.0, (-m_min - 7.0) / 12.0f, 1.0, (-m_max + 6.0) / 12.0f));
 
 	// Draw notes
-	for (Notes::const_iterator it = m_songit; it != m_vocal.notes.end() && it->begin < m_time - (baseLine - 0.5) / pixUnit; ++it) {
-		if (it->type == Note::SLEEP) continue;
-		double alpha = it->power;
+	NoteTimeline const& notes = m_vocal.timeline;
+	for (std::size_t i = m_songit; i < notes.size() && notes.begin[i] < m_time - (baseLine - 0.5) / pixUnit; ++i) {
+		if (notes.sleep(i)) continue;
+		double alpha = m_vocal.states.getPower(i);
+		double const begin = notes.begin[i], end = notes.end[i];
 		Texture* t1;
 		Texture* t2;
-		switch (it->type) {
+		switch (notes.type[i]) {
 		  case Note::NORMAL: case Note::SLIDE: t1 = &m_notebar; t2 = &m_notebar_hl; break;
 		  case Note::GOLDEN: t1 = &m_notebargold; t2 = &m_notebargold_hl; break;
 		  case Note::FREESTYLE:  // Freestyle notes use custom handling
 			{
 				Dimensions dim;
-				dim.middle(m_baseX + 0.5 * (it->begin + it->end) * pixUnit).center(m_baseY + it->note * m_noteUnit).stretch((it->end - it->begin) * pixUnit, -m_noteUnit * 12.0);
+				dim.middle(m_baseX + 0.5 * (begin + end) * pixUnit).center(m_baseY + notes.note[i] * m_noteUnit).stretch((end - begin) * pixUnit, -m_noteUnit * 12.0);
 				float xoffset = 0.1 * m_time / m_notebarfs.ar();
 				m_notebarfs.draw(dim, TexCoords(xoffset, 0.0, xoffset + dim.ar() / m_notebarfs.ar(), 1.0));
 				if (alpha > 0.0) {
@@ -173,10 +179,10 @@ void NoteGraph::drawNotes() {
 			continue;
 		  default: throw std::logic_error("Unknown note type: don't know how to render");
 		}
-		double x = m_baseX + it->begin * pixUnit + m_noteUnit; // left x coordinate: begin minus border (side borders -noteUnit wide)
-		double ybeg = m_baseY + (it->notePrev + 1) * m_noteUnit; // top y coordinate (on the one higher note line)
-		double yend = m_baseY + (it->note + 1) * m_noteUnit; // top y coordinate (on the one higher note line)
-		double w = (it->end - it->begin) * pixUnit - m_noteUnit * 2.0; // width: including borders on both sides
+		double x = m_baseX + begin * pixUnit + m_noteUnit; // left x coordinate: begin minus border (side borders -noteUnit wide)
+		double ybeg = m_baseY + (notes.notePrev[i] + 1) * m_noteUnit; // top y coordinate (on the one higher note line)
+		double yend = m_baseY + (notes.note[i] + 1) * m_noteUnit; // top y coordinate (on the one higher note line)
+		double w = (end - begin) * pixUnit - m_noteUnit * 2.0; // width: including borders on both sides
 		double h = -m_noteUnit * 2.0; // height: 0.5 border + 1.0 bar + 0.5 border = 2.0
 		drawNotebar(*t1, x, ybeg, yend, w, h);
 		if (alpha > 0.0) {
@@ -194,7 +200,8 @@ namespace {
 }
 
 void NoteGraph::drawWaves(Database const& database) {
-	if (m_vocal.notes.empty()) return; // Cannot draw without notes
+	NoteTimeline const& notes = m_vocal.timeline;
+	if (notes.size() == 0) return; // Cannot draw without notes
 	UseTexture tblock(m_wave);
 	for (std::list<Player>::const_iterator p = database.cur.begin(); p != database.cur.end(); ++p) {
 		if (p->m_vocal.name != m_vocal.name)
@@ -211,7 +218,7 @@ void NoteGraph::drawWaves(Database const& database) {
 		double t = idx * Engine::TIMESTEP;
 		double oldval = getNaN();
 		glutil::VertexArray va;
-		Notes::const_iterator noteIt = m_vocal.notes.begin();
+		std::size_t noteIt = 0;
 		glmath::vec4 c(p->m_color.r, p->m_color.g, p->m_color.b, 1.0);
 		for (; idx < endIdx; ++idx, t += Engine::TIMESTEP) {
 			double const freq = pitch[idx].first;
@@ -221,15 +228,15 @@ void NoteGraph::drawWaves(Database const& database) {
 			if (idx < beginIdx) continue; // Skip graphics rendering if out of screen
 			double x = -0.2 + (t - m_time) * pixUnit;
 			// Find the currently active note(s)
-			while (noteIt != m_vocal.notes.end() && (noteIt->type == Note::SLEEP || t > noteIt->end)) ++noteIt;
-			Notes::const_iterator notePrev = noteIt;
-			while (notePrev != m_vocal.notes.begin() && (notePrev->type == Note::SLEEP || t < notePrev->begin)) --notePrev;
-			bool hasNote = (noteIt != m_vocal.notes.end());
-			bool hasPrev = notePrev->type != Note::SLEEP && t >= notePrev->begin;
+			while (noteIt < notes.size() && (notes.sleep(noteIt) || t > notes.end[noteIt])) ++noteIt;
+			std::size_t notePrev = std::min(noteIt, notes.size() - 1);
+			while (notePrev > 0 && (notes.sleep(notePrev) || t < notes.begin[notePrev])) --notePrev;
+			bool hasNote = (noteIt < notes.size());
+			bool hasPrev = !notes.sleep(notePrev) && t >= notes.begin[notePrev];
 			double val;
-			if (hasNote && hasPrev) val = 0.5 * (noteIt->note + notePrev->note);
-			else if (hasNote) val = noteIt->note;
-			else val = notePrev->note;
+			if (hasNote && hasPrev) val = 0.5 * (notes.note[noteIt] + notes.note[notePrev]);
+			else if (hasNote) val = notes.note[noteIt];
+			else val = notes.note[notePrev];
 			// Now val contains the active note value. The following calculates note value for current freq:
 			val += Note::diff(val, m_vocal.scale.getNote(freq));
 			// Graphics positioning & animation:
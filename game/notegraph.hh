@@ -12,7 +12,7 @@ class NoteGraph {
   public:
 	enum Position {FULLSCREEN, TOP, BOTTOM, LEFT, RIGHT};
 	/// constructor
-	NoteGraph(VocalTrack const& vocal);
+	NoteGraph(VocalTrack& vocal);
 	/// resets NoteGraph and Notes
 	void reset();
 	/** draws NoteGraph (notelines, notes, waves)
@@ -38,7 +38,7 @@ class NoteGraph {
 	Texture m_notebargold_hl;
 	float m_notealpha;
 	AnimValue m_nlTop, m_nlBottom;
-	Notes::const_iterator m_songit;
+	std::size_t m_songit; ///< first note to draw (in m_vocal.timeline)
 	double m_time;
 	double m_max, m_min, m_noteUnit, m_baseY, m_baseX;
 
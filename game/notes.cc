@@ -5,45 +5,64 @@
 #include <sstream>
 #include <stdexcept>
 
-Note::Note(): begin(getNaN()), end(getNaN()), phase(getNaN()), power(getNaN()), type(NORMAL), note(), notePrev() {}
+Note::Note(): begin(getNaN()), end(getNaN()), phase(getNaN()), type(NORMAL), note(), notePrev() {}
 
-double Note::diff(double note, double n) { return remainder(n - note, 12.0); }
-double Note::maxScore() const { return scoreMultiplier() * (end - begin); }
-
-double Note::clampDuration(double b, double e) const {
-	double len = std::min(e, end) - std::max(b, begin);
-	return len > 0.0 ? len : 0.0;
+namespace {
+	double scoreMultiplier(Note::Type type) {
+		switch(type) {
+			case Note::GOLDEN:
+				return 2.0;
+			case Note::SLEEP:
+				return 0.0;
+			case Note::FREESTYLE:
+			case Note::NORMAL:
+			case Note::SLIDE:
+			case Note::TAP:
+			case Note::HOLDBEGIN:
+			case Note::HOLDEND:
+			case Note::ROLL:
+			case Note::MINE:
+			case Note::LIFT:
+				return 1.0;
+		}
+		return 0.0;
+	}
+	double clampDuration(double begin, double end, double b, double e) {
+		double len = std::min(e, end) - std::max(b, begin);
+		return len > 0.0 ? len : 0.0;
+	}
+	double powerFactor(Note::Type type, double note, double n) {
+		if (type == Note::FREESTYLE) return 1.0;
+		double error = std::abs(Note::diff(note, n));
+		return clamp(1.5 - error, 0.0, 1.0);
+	}
 }
 
-double Note::score(double n, double b, double e) const {
-	return scoreMultiplier() * powerFactor(n) * clampDuration(b, e);
-}
+double Note::diff(double note, double n) { return remainder(n - note, 12.0); }
+double Note::maxScore() const { return scoreMultiplier() * (end - begin); }
+double Note::clampDuration(double b, double e) const { return ::clampDuration(begin, end, b, e); }
+double Note::score(double n, double b, double e) const { return scoreMultiplier() * powerFactor(n) * clampDuration(b, e); }
+double Note::scoreMultiplier() const { return ::scoreMultiplier(type); }
+double Note::powerFactor(double n) const { return ::powerFactor(type, note, n); }
 
-double Note::scoreMultiplier() const {
-	switch(type) {
-		case GOLDEN:
-			return 2.0;
-		case SLEEP:
-			return 0.0;
-		case FREESTYLE:
-		case NORMAL:
-		case SLIDE:
-		case TAP:
-		case HOLDBEGIN:
-		case HOLDEND:
-		case ROLL:
-		case MINE:
-		case LIFT:
-			return 1.0;
+void NoteTimeline::assign(Notes const& notes) {
+	std::size_t const n = notes.size();
+	begin.resize(n); end.resize(n); note.resize(n); notePrev.resize(n); type.resize(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		begin[i] = notes[i].begin;
+		end[i] = notes[i].end;
+		note[i] = notes[i].note;
+		notePrev[i] = notes[i].notePrev;
+		type[i] = notes[i].type;
 	}
-	return 0.0;
 }
 
-double Note::powerFactor(double note) const {
-	if (type == FREESTYLE) return 1.0;
-	double error = std::abs(diff(note));
-	return clamp(1.5 - error, 0.0, 1.0);
+double NoteTimeline::maxScore(std::size_t i) const { return ::scoreMultiplier(Note::Type(type[i])) * (end[i] - begin[i]); }
+double NoteTimeline::clampDuration(std::size_t i, double b, double e) const { return ::clampDuration(begin[i], end[i], b, e); }
+double NoteTimeline::score(std::size_t i, double n, double b, double e) const {
+	return ::scoreMultiplier(Note::Type(type[i])) * powerFactor(i, n) * clampDuration(i, b, e);
 }
+double NoteTimeline::powerFactor(std::size_t i, double n) const { return ::powerFactor(Note::Type(type[i]), note[i], n); }
 
 Duration::Duration(): begin(getNaN()), end(getNaN()) {}
 
@@ -53,6 +72,8 @@ VocalTrack::VocalTrack(std::string name) : name(name) {reload();}
 
 void VocalTrack::reload() {
 	notes.clear();
+	timeline.assign(notes);
+	states.reset(0);
 	m_scoreFactor = 0.0;
 	noteMin = std::numeric_limits<int>::max();
 	noteMax = std::numeric_limits<int>::min();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <boost/cstdint.hpp>
 #include <map>
 #include <string>
 #include <vector>
@@ -56,10 +58,6 @@ struct Note {
 	double begin, ///< begin time
 	       end; ///< end time
 	double phase; /// Position within a measure, [0, 1)
-	/// power of note (how well it is being hit right now)
-	mutable double power;
-	/// which players sung well
-	mutable std::vector<Color> stars;
 	/// note type
 	enum Type { FREESTYLE = 'F', NORMAL = ':', GOLDEN = '*', SLIDE = '+', SLEEP = '-',
 	  TAP = '1', HOLDBEGIN = '2', HOLDEND = '3', ROLL = '4', MINE = 'M', LIFT = 'L'} type;
@@ -89,15 +87,59 @@ struct Note {
 
 typedef std::vector<Note> Notes;
 
+/**
+* @short Timing, pitch and type of the notes of a vocal track as separate arrays, indexed like the notes.
+* The drawing and scoring loops walk these instead of the Note records (which also hold the syllables).
+**/
+struct NoteTimeline {
+	std::vector<float> begin, end; ///< times in seconds
+	std::vector<boost::int16_t> note, notePrev; ///< MIDI pitches (see Note)
+	std::vector<char> type; ///< Note::Type
+	/// copy the notes (once they are final)
+	void assign(Notes const& notes);
+	std::size_t size() const { return type.size(); }
+	bool sleep(std::size_t i) const { return type[i] == Note::SLEEP; }
+	/// the same as in Note, for note i
+	double maxScore(std::size_t i) const;
+	double clampDuration(std::size_t i, double b, double e) const;
+	double score(std::size_t i, double n, double b, double e) const;
+	double powerFactor(std::size_t i, double n) const;
+};
+
+/// Runtime state of the notes of a vocal track while it is being sung (the notes themselves never change)
+struct NoteStates {
+	/// A star for a well sung note
+	struct Star {
+		Star(unsigned n, Color const& c): note(n), color(c) {}
+		unsigned note; ///< index of the note in VocalTrack::notes
+		Color color; ///< color of the player who got it
+		static bool ltNote(Star const& s, unsigned n) { return s.note < n; }
+		static bool gtNote(unsigned n, Star const& s) { return n < s.note; }
+	};
+	typedef std::vector<Star> Stars;
+	/// clear everything for a track with the given number of notes
+	void reset(std::size_t notes) { power.assign(notes, 0.0f); stars.clear(); }
+	/// power of a note (how well it is being hit right now)
+	float getPower(std::size_t note) const { return note < power.size() ? power[note] : 0.0f; }
+	/// add a star, keeping the list sorted by note (players finish notes in their own order)
+	void addStar(unsigned note, Color const& color) {
+		stars.insert(std::upper_bound(stars.begin(), stars.end(), note, Star::gtNote), Star(note, color));
+	}
+	std::vector<float> power; ///< power of each note
+	Stars stars; ///< stars sorted by note, in the order they were earned within a note
+};
+
 struct VocalTrack {
 	VocalTrack(std::string name);
 	void reload();
 	std::string name;
 	Notes notes;
+	NoteTimeline timeline; ///< notes for drawing and scoring (updated by SongParser)
 	int noteMin, noteMax; ///< lowest and highest note
 	double beginTime, endTime; ///< the period where there are notes
 	double m_scoreFactor; ///< normalization factor for the scoring system
 	MusicalScale scale; ///< scale in which song is sung
+	NoteStates states; ///< state of the notes while singing (shared by all players of the track)
 };
 
 typedef std::map<std::string, VocalTrack> VocalTracks;
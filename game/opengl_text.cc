@@ -1,95 +1,266 @@
 #include "opengl_text.hh"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/weak_ptr.hpp>
 #include <libxml++/libxml++.h>
 #include <pango/pangocairo.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 
-OpenGLText::OpenGLText(TThemeTxtOpenGL& _text, double m) {
-	if (_text.fontfamily.empty()) _text.fontfamily = "Arial";
+namespace {
+	const unsigned PAGE_SIZE = 1024;  ///< Size of atlas textures (larger if a glyph does not fit)
+	const unsigned SUBPIXELS = 4;  ///< Horizontal glyph positions rasterized per pixel
+	const int PAD = 1;  ///< Transparent border around each glyph, for bilinear filtering
+
+	PangoAlignment parseAlignment(std::string const& align) {
+		if (align == "center") return PANGO_ALIGN_CENTER;
+		if (align == "end") return PANGO_ALIGN_RIGHT;
+		return PANGO_ALIGN_LEFT;
+	}
+}
 
-	PangoAlignment alignment = PANGO_ALIGN_LEFT;
-	if (_text.fontalign == "start") alignment = PANGO_ALIGN_LEFT;
-	else if (_text.fontalign == "center") alignment = PANGO_ALIGN_CENTER;
-	else if (_text.fontalign == "end") alignment = PANGO_ALIGN_RIGHT;
+/**
+* @short Glyphs of one text style rasterized into textures.
+* Glyphs are rasterized when first used, fill and outline separately, and packed
+* in rows into atlas pages. Shared by all OpenGLText objects of the same style.
+**/
+class GlyphAtlas: boost::noncopyable {
+  public:
+	/// A rasterized glyph
+	struct Cell {
+		unsigned page;
+		int x, y; ///< Top-left corner relative to the pen position (pixels)
+		unsigned w, h; ///< Size (pixels)
+		TexCoords tex; ///< Texture coordinates within the page
+	};
+	/// Get the atlas for a style and scale, creating it if needed
+	static boost::shared_ptr<GlyphAtlas> get(TThemeTxtOpenGL const& style, double m);
+	~GlyphAtlas();
+	/// Context for laying out text in this style
+	PangoContext* context() { return m_context; }
+	/// Font of this style
+	PangoFontDescription const* font() const { return m_desc; }
+	/// Outline thickness (pixels)
+	double border() const { return m_border; }
+	/// Test if the style has an outline
+	bool stroked() const { return m_style.stroke_col.a > 0.0 && m_border > 0.0; }
+	/// Get the fill or the outline of a glyph (rasterized when first used)
+	Cell const& cell(PangoFont* font, PangoGlyph glyph, unsigned subpixel, bool stroke);
+	/// Get an atlas page
+	OpenGLTexture<GL_TEXTURE_2D>& page(unsigned i) { return m_pages[i]; }
+  private:
+	GlyphAtlas(TThemeTxtOpenGL const& style, double m);
+	void place(Cell& cell, Bitmap const& bitmap);
+	struct Key {
+		PangoFont* font;
+		PangoGlyph glyph;
+		unsigned subpixel;
+		bool stroke;
+		Key(PangoFont* f, PangoGlyph g, unsigned s, bool st): font(f), glyph(g), subpixel(s), stroke(st) {}
+		bool operator<(Key const& k) const {
+			if (font != k.font) return font < k.font;
+			if (glyph != k.glyph) return glyph < k.glyph;
+			if (subpixel != k.subpixel) return subpixel < k.subpixel;
+			return stroke < k.stroke;
+		}
+	};
+	typedef std::map<Key, Cell> Cells;
+	TThemeTxtOpenGL m_style;
+	double m_border;
+	PangoFontDescription* m_desc;
+	PangoContext* m_context;
+	std::set<PangoFont*> m_fonts; ///< Fonts referenced by m_cells (kept alive so that the pointers stay unique)
+	Cells m_cells;
+	boost::ptr_vector<OpenGLTexture<GL_TEXTURE_2D> > m_pages;
+	unsigned m_pageSize; ///< Size of the last page
+	unsigned m_rowX, m_rowY, m_rowH; ///< Free position and height of the current row on the last page
+};
+
+boost::shared_ptr<GlyphAtlas> GlyphAtlas::get(TThemeTxtOpenGL const& style, double m) {
+	typedef std::map<std::string, boost::weak_ptr<GlyphAtlas> > Atlases;
+	static Atlases atlases;
+	std::ostringstream oss;
+	oss << style.fontfamily << '\n' << style.fontstyle << '\n' << style.fontweight << '\n' << style.fontsize * m << '\n' << style.stroke_width * m
+	  << '\n' << style.fill_col.r << ' ' << style.fill_col.g << ' ' << style.fill_col.b << ' ' << style.fill_col.a
+	  << '\n' << style.stroke_col.r << ' ' << style.stroke_col.g << ' ' << style.stroke_col.b << ' ' << style.stroke_col.a;
+	boost::weak_ptr<GlyphAtlas>& weak = atlases[oss.str()];
+	boost::shared_ptr<GlyphAtlas> atlas = weak.lock();
+	if (!atlas) {
+		atlas.reset(new GlyphAtlas(style, m));
+		weak = atlas;
+	}
+	return atlas;
+}
 
+GlyphAtlas::GlyphAtlas(TThemeTxtOpenGL const& style, double m):
+  m_style(style), m_border(style.stroke_width * m), m_pageSize(), m_rowX(), m_rowY(), m_rowH()
+{
 	PangoWeight weight = PANGO_WEIGHT_NORMAL;
-	if (_text.fontweight == "normal") weight = PANGO_WEIGHT_NORMAL;
-	else if (_text.fontweight == "bold") weight = PANGO_WEIGHT_BOLD;
-	else if (_text.fontweight == "bolder") weight = PANGO_WEIGHT_ULTRABOLD;
+	if (style.fontweight == "normal") weight = PANGO_WEIGHT_NORMAL;
+	else if (style.fontweight == "bold") weight = PANGO_WEIGHT_BOLD;
+	else if (style.fontweight == "bolder") weight = PANGO_WEIGHT_ULTRABOLD;
 
-	PangoStyle style = PANGO_STYLE_NORMAL;
-	if (_text.fontstyle == "normal") style = PANGO_STYLE_NORMAL;
-	else if (_text.fontstyle == "italic") style = PANGO_STYLE_ITALIC;
-	else if (_text.fontstyle == "oblique") style = PANGO_STYLE_OBLIQUE;
+	PangoStyle fontstyle = PANGO_STYLE_NORMAL;
+	if (style.fontstyle == "normal") fontstyle = PANGO_STYLE_NORMAL;
+	else if (style.fontstyle == "italic") fontstyle = PANGO_STYLE_ITALIC;
+	else if (style.fontstyle == "oblique") fontstyle = PANGO_STYLE_OBLIQUE;
 
 	// set font description
-	PangoFontDescription *desc = pango_font_description_new();
-	pango_font_description_set_weight(desc, weight);
-	pango_font_description_set_style(desc, style);
-	pango_font_description_set_family(desc, _text.fontfamily.c_str());
-	pango_font_description_set_absolute_size(desc, _text.fontsize * PANGO_SCALE * m);
-
-	double border = _text.stroke_width * m;
-	double margin = 2.0 * border;
-
-	// compute text extents
-	{
-		PangoContext* ctx = pango_font_map_create_context(pango_cairo_font_map_get_default());
-		PangoLayout* layout = pango_layout_new(ctx);
-		pango_layout_set_alignment(layout, alignment);
-		pango_layout_set_font_description (layout, desc);
-		pango_layout_set_text (layout, _text.text.c_str(), -1);
-		PangoRectangle rec1, rec2;
-		pango_layout_get_pixel_extents (layout,&rec1,&rec2);
-		m_x = rec2.width + 2.0 * margin;
-		m_y = rec2.height + 2.0 * margin;
-		m_x_advance = rec1.x;
-		m_y_advance = rec1.y;
-		g_object_unref (layout);
-		g_object_unref (ctx);
-	}
+	m_desc = pango_font_description_new();
+	pango_font_description_set_weight(m_desc, weight);
+	pango_font_description_set_style(m_desc, fontstyle);
+	pango_font_description_set_family(m_desc, style.fontfamily.c_str());
+	pango_font_description_set_absolute_size(m_desc, style.fontsize * PANGO_SCALE * m);
+	m_context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+}
 
-	// create surface
-	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, m_x, m_y);
-	cairo_t *dc = cairo_create(surface);
+GlyphAtlas::~GlyphAtlas() {
+	for (std::set<PangoFont*>::const_iterator it = m_fonts.begin(); it != m_fonts.end(); ++it) g_object_unref(*it);
+	g_object_unref(m_context);
+	pango_font_description_free(m_desc);
+}
 
-	// draw the surface
-	PangoLayout* layout = pango_cairo_create_layout(dc);
-	pango_layout_set_alignment(layout, alignment);
-	pango_layout_set_font_description(layout, desc);
-	pango_layout_set_text(layout, _text.text.c_str(), -1);
-	cairo_save(dc);
-	cairo_move_to(dc, margin, margin);
-	pango_cairo_show_layout (dc, layout);
-	pango_cairo_layout_path(dc, layout);
-	if (_text.fill_col.a > 0.0) {
-		cairo_set_source_rgba(dc, _text.fill_col.r, _text.fill_col.g, _text.fill_col.b, _text.fill_col.a);
-		cairo_fill_preserve(dc);
-	}
-	if (_text.stroke_col.a > 0.0) {
-		cairo_set_line_width(dc, border);
-		cairo_set_source_rgba(dc, _text.stroke_col.r, _text.stroke_col.g, _text.stroke_col.b, _text.stroke_col.a);
+GlyphAtlas::Cell const& GlyphAtlas::cell(PangoFont* font, PangoGlyph glyph, unsigned subpixel, bool stroke) {
+	Key key(font, glyph, subpixel, stroke);
+	Cells::const_iterator it = m_cells.find(key);
+	if (it != m_cells.end()) return it->second;
+	if (m_fonts.insert(font).second) g_object_ref(font);
+	// Cell size: ink extents, the outline, room for the subpixel offset and padding
+	PangoRectangle ink;
+	pango_font_get_glyph_extents(font, glyph, &ink, NULL);
+	int margin = int(std::ceil(m_border)) + PAD;
+	Cell c;
+	c.x = PANGO_PIXELS_FLOOR(ink.x) - margin;
+	c.y = PANGO_PIXELS_FLOOR(ink.y) - margin;
+	c.w = PANGO_PIXELS_CEIL(ink.x + ink.width) + 1 + margin - c.x;
+	c.h = PANGO_PIXELS_CEIL(ink.y + ink.height) + margin - c.y;
+	// Rasterize the same way as whole texts used to be: the glyph in black covered by the fill, or the outline
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, c.w, c.h);
+	cairo_t* dc = cairo_create(surface);
+	PangoGlyphString* glyphs = pango_glyph_string_new();
+	pango_glyph_string_set_size(glyphs, 1);
+	PangoGlyphInfo& info = glyphs->glyphs[0];
+	info.glyph = glyph;
+	info.geometry.width = info.geometry.x_offset = info.geometry.y_offset = 0;
+	info.attr.is_cluster_start = 1;
+	double penX = -c.x + double(subpixel) / SUBPIXELS;
+	double penY = -c.y;
+	if (!stroke) {
+		cairo_move_to(dc, penX, penY);
+		pango_cairo_show_glyph_string(dc, font, glyphs);
+		cairo_move_to(dc, penX, penY);
+		pango_cairo_glyph_string_path(dc, font, glyphs);
+		Color const& col = m_style.fill_col;
+		if (col.a > 0.0) {
+			cairo_set_source_rgba(dc, col.r, col.g, col.b, col.a);
+			cairo_fill(dc);
+		}
+	} else {
+		cairo_move_to(dc, penX, penY);
+		pango_cairo_glyph_string_path(dc, font, glyphs);
+		Color const& col = m_style.stroke_col;
+		cairo_set_line_width(dc, m_border);
+		cairo_set_source_rgba(dc, col.r, col.g, col.b, col.a);
 		cairo_stroke(dc);
 	}
-	pango_cairo_update_layout (dc, layout);
-	cairo_restore(dc);
-	g_object_unref(layout);
-
-	// TODO: Avoid copying of bitmap data?
+	pango_glyph_string_free(glyphs);
+	cairo_surface_flush(surface);
 	Bitmap bitmap;
 	bitmap.fmt = pix::INT_ARGB;
-	bitmap.resize(cairo_image_surface_get_width(surface), cairo_image_surface_get_height(surface));
+	bitmap.resize(c.w, c.h);
 	std::memcpy(&bitmap.buf[0], cairo_image_surface_get_data(surface), bitmap.buf.size());
-	m_surface.load(bitmap);
-
-	// delete surface
 	cairo_destroy(dc);
 	cairo_surface_destroy(surface);
-	// delete the font description
-	pango_font_description_free(desc);
+	place(c, bitmap);
+	return m_cells.insert(std::make_pair(key, c)).first->second;
+}
+
+void GlyphAtlas::place(Cell& c, Bitmap const& bitmap) {
+	// Fill rows left to right, start a new row or a new page when full
+	if (!m_pages.empty() && m_rowX + c.w > m_pageSize) { m_rowX = 0; m_rowY += m_rowH; m_rowH = 0; }
+	if (m_pages.empty() || m_rowY + c.h > m_pageSize || c.w > m_pageSize) {
+		m_pageSize = PAGE_SIZE;
+		while (m_pageSize < c.w || m_pageSize < c.h) m_pageSize *= 2;
+		m_pages.push_back(new OpenGLTexture<GL_TEXTURE_2D>());
+		UseTexture tex(m_pages.back());
+		clearTexture(GL_TEXTURE_2D, m_pageSize, m_pageSize);
+		m_rowX = m_rowY = m_rowH = 0;
+	}
+	{
+		UseTexture tex(m_pages.back());
+		loadTextureRegion(GL_TEXTURE_2D, bitmap, m_rowX, m_rowY);
+	}
+	c.page = m_pages.size() - 1;
+	float size = m_pageSize;
+	c.tex = TexCoords(m_rowX / size, m_rowY / size, (m_rowX + c.w) / size, (m_rowY + c.h) / size);
+	m_rowX += c.w;
+	m_rowH = std::max(m_rowH, c.h);
+}
+
+namespace {
+	/// Add a quad for each glyph (fill or outline) of a layout drawn at (margin, margin)
+	void addGlyphs(std::vector<OpenGLText::Quad>& quads, GlyphAtlas& atlas, PangoLayout* layout, double margin, bool stroke) {
+		PangoLayoutIter* it = pango_layout_get_iter(layout);
+		do {
+			PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+			if (!run) continue;  // End of line
+			PangoRectangle logical;
+			pango_layout_iter_get_run_extents(it, NULL, &logical);
+			double baseline = margin + double(pango_layout_iter_get_baseline(it)) / PANGO_SCALE;
+			int x = logical.x;
+			for (int i = 0; i < run->glyphs->num_glyphs; x += run->glyphs->glyphs[i].geometry.width, ++i) {
+				PangoGlyphInfo const& info = run->glyphs->glyphs[i];
+				if (info.glyph == PANGO_GLYPH_EMPTY) continue;
+				// Pen position: whole pixels and the subpixel offset rasterized into the glyph
+				double px = margin + double(x + info.geometry.x_offset) / PANGO_SCALE;
+				double py = baseline + double(info.geometry.y_offset) / PANGO_SCALE;
+				double ix = std::floor(px);
+				unsigned subpixel = std::min(SUBPIXELS - 1, unsigned((px - ix) * SUBPIXELS));
+				GlyphAtlas::Cell const& c = atlas.cell(run->item->analysis.font, info.glyph, subpixel, stroke);
+				OpenGLText::Quad q;
+				q.page = c.page;
+				q.x1 = ix + c.x;
+				q.y1 = std::floor(py + 0.5) + c.y;
+				q.x2 = q.x1 + c.w;
+				q.y2 = q.y1 + c.h;
+				q.tex = c.tex;
+				quads.push_back(q);
+			}
+		} while (pango_layout_iter_next_run(it));
+		pango_layout_iter_free(it);
+	}
+}
+
+OpenGLText::OpenGLText(TThemeTxtOpenGL& _text, double m) {
+	if (_text.fontfamily.empty()) _text.fontfamily = "Arial";
+	m_atlas = GlyphAtlas::get(_text, m);
+	double margin = 2.0 * m_atlas->border();
+
+	PangoLayout* layout = pango_layout_new(m_atlas->context());
+	pango_layout_set_alignment(layout, parseAlignment(_text.fontalign));
+	pango_layout_set_font_description(layout, m_atlas->font());
+	pango_layout_set_text(layout, _text.text.c_str(), -1);
+	// compute text extents
+	PangoRectangle rec1, rec2;
+	pango_layout_get_pixel_extents(layout, &rec1, &rec2);
+	m_x = rec2.width + 2.0 * margin;
+	m_y = rec2.height + 2.0 * margin;
+	m_x_advance = rec1.x;
+	m_y_advance = rec1.y;
+	m_width = m_x;
+	m_height = m_y;
+	m_dimensions = Dimensions(float(m_width) / m_height).fixedWidth(1.0f);
+	// Outlines are drawn over all the fills, as when stroking the whole text at once
+	addGlyphs(m_quads, *m_atlas, layout, margin, false);
+	if (m_atlas->stroked()) addGlyphs(m_quads, *m_atlas, layout, margin, true);
+	g_object_unref(layout);
+
 	m_x /= m;
 	m_y /= m;
 	m_x_advance /= m;
@@ -97,13 +268,36 @@ OpenGLText::OpenGLText(TThemeTxtOpenGL& _text, double m) {
 }
 
 void OpenGLText::draw() {
-	m_surface.draw();
+	if (m_width == 0 || m_height == 0) return;
+	// Map the area of the text selected by m_tex to m_dimensions, clipping glyphs outside it
+	float x0 = m_dimensions.x1(), y0 = m_dimensions.y1(), w = m_dimensions.w(), h = m_dimensions.h();
+	float tw = m_tex.x2 - m_tex.x1, th = m_tex.y2 - m_tex.y1;
+	float ux1 = std::min(m_tex.x1, m_tex.x2), ux2 = std::max(m_tex.x1, m_tex.x2);
+	float uy1 = std::min(m_tex.y1, m_tex.y2), uy2 = std::max(m_tex.y1, m_tex.y2);
+	for (std::vector<Quad>::const_iterator it = m_quads.begin(); it != m_quads.end(); ++it) {
+		float u1 = it->x1 / m_width, u2 = it->x2 / m_width;
+		float v1 = it->y1 / m_height, v2 = it->y2 / m_height;
+		float cu1 = std::max(u1, ux1), cu2 = std::min(u2, ux2);
+		float cv1 = std::max(v1, uy1), cv2 = std::min(v2, uy2);
+		if (cu1 >= cu2 || cv1 >= cv2) continue;
+		TexCoords const& t = it->tex;
+		TexCoords tex(
+		  t.x1 + (cu1 - u1) / (u2 - u1) * (t.x2 - t.x1),
+		  t.y1 + (cv1 - v1) / (v2 - v1) * (t.y2 - t.y1),
+		  t.x1 + (cu2 - u1) / (u2 - u1) * (t.x2 - t.x1),
+		  t.y1 + (cv2 - v1) / (v2 - v1) * (t.y2 - t.y1));
+		float x1 = x0 + (cu1 - m_tex.x1) / tw * w;
+		float x2 = x0 + (cu2 - m_tex.x1) / tw * w;
+		float y1 = y0 + (cv1 - m_tex.y1) / th * h;
+		float y2 = y0 + (cv2 - m_tex.y1) / th * h;
+		m_atlas->page(it->page).draw(Dimensions(x1, y1, x2 - x1, y2 - y1), tex);
+	}
 }
 
 void OpenGLText::draw(Dimensions &_dim, TexCoords &_tex) {
-	m_surface.dimensions = _dim;
-	m_surface.tex = _tex;
-	m_surface.draw();
+	m_dimensions = _dim;
+	m_tex = _tex;
+	draw();
 }
 
 void parseTheme( std::string _theme_file, TThemeTxtOpenGL &_theme, double &_width, double &_height, double &_x, double &_y, SvgTxtTheme::Align& _align) {
@@ -3,6 +3,7 @@
 #include "color.hh"
 #include "surface.hh"
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <vector>
 
@@ -35,13 +36,21 @@ struct TThemeTxtOpenGL {
 	TThemeTxtOpenGL(): stroke_width(), fontsize() {}
 };
 
-/// this class will enable to create a texture from a themed text structure
-/** it will not cache any data (class using this class should)
- * it provides size of the texture are drawn (x,y)
- * it provides size of the texture created (x_power_of_two, y_power_of_two)
+class GlyphAtlas;
+
+/// this class will enable to draw a themed text structure
+/** the glyphs are rasterized once per style into a shared texture atlas and
+ * the text is drawn as one quad per glyph (fills first, then outlines)
+ * it provides size of the area drawn (x,y)
  */
 class OpenGLText {
   public:
+	/// a glyph (fill or outline) placed in the text
+	struct Quad {
+		unsigned page; ///< atlas page
+		float x1, y1, x2, y2; ///< position within the text (pixels)
+		TexCoords tex; ///< texture coordinates within the page
+	};
 	/// constructor
 	OpenGLText(TThemeTxtOpenGL &_text, double m);
 	/// draws area
@@ -57,14 +66,18 @@ class OpenGLText {
 	/// @return y_advance
 	double y_advance() const { return m_y_advance; }
 	/// @returns dimension of texture
-	Dimensions& dimensions() { return m_surface.dimensions; }
+	Dimensions& dimensions() { return m_dimensions; }
 
   private:
 	double m_x;
 	double m_y;
 	double m_x_advance;
 	double m_y_advance;
-	Surface m_surface;
+	unsigned m_width, m_height; ///< size of the text area in pixels
+	Dimensions m_dimensions;
+	TexCoords m_tex;
+	boost::shared_ptr<GlyphAtlas> m_atlas;
+	std::vector<Quad> m_quads;
 };
 
 /// themed svg texts (simple)
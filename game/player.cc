@@ -7,10 +7,10 @@ Player::Player(VocalTrack& vocal, Analyzer& analyzer, size_t frames):
 	  m_vocal(vocal), m_analyzer(analyzer), m_pitch(frames, std::make_pair(getNaN(),
 	  -getInf())), m_pos(), m_score(), m_noteScore(), m_lineScore(), m_maxLineScore(),
 	  m_prevLineScore(-1), m_feedbackFader(0.0, 2.0), m_activitytimer(),
-	  m_scoreIt(m_vocal.notes.begin())
+	  m_scoreIdx()
 {
 	// Initialize note powers
-	for (Notes::const_iterator it = m_vocal.notes.begin(); it != m_vocal.notes.end(); ++it) it->power = 0.0f;
+	m_vocal.states.reset(m_vocal.notes.size());
 	// Assign colors
 	if (m_analyzer.getId() == "blue") m_color = Color(0.2, 0.5, 0.7);
 	else if (m_analyzer.getId() == "red") m_color = Color(0.8, 0.3, 0.3);
@@ -33,37 +33,41 @@ void Player::update() {
 	}
 	double endTime = Engine::TIMESTEP * m_pos;
 	// Iterate over all the notes that are considered for this timestep
-	while (m_scoreIt != m_vocal.notes.end()) {
-		if (endTime < m_scoreIt->begin) break;  // The note begins later than on this timestep
+	NoteTimeline const& notes = m_vocal.timeline;
+	while (m_scoreIdx < notes.size()) {
+		std::size_t const idx = m_scoreIdx;
+		if (endTime < notes.begin[idx]) break;  // The note begins later than on this timestep
+		float& power = m_vocal.states.power[idx];
 		// If tone was detected, calculate score
-		m_scoreIt->power *= std::pow(0.05, m_scoreIt->clampDuration(beginTime, endTime));  // Fade glow
+		power *= std::pow(0.05, notes.clampDuration(idx, beginTime, endTime));  // Fade glow
 		if (t) {
 			double note = m_vocal.scale.getNote(t->freq);
 			// Add score
-			double score_addition = m_vocal.m_scoreFactor * m_scoreIt->score(note, beginTime, endTime);
+			double score_addition = m_vocal.m_scoreFactor * notes.score(idx, note, beginTime, endTime);
 			m_score += score_addition;
 			m_noteScore += score_addition;
 			m_lineScore += score_addition;
 			// Add power if already on the note
-			m_scoreIt->power = std::max(m_scoreIt->power, m_scoreIt->powerFactor(note));
+			power = std::max(power, float(notes.powerFactor(idx, note)));
 		}
 		// If a row of lyrics ends, calculate how well it went
-		if (m_scoreIt->type == Note::SLEEP) {
+		if (notes.sleep(idx)) {
 			calcRowRank();
 		} else {
 			m_maxLineScore = 0; // Not in SLEEP note anymore, so reset maximum
 		}
-		if (endTime < m_scoreIt->end) break;  // The note continues past this timestep
+		if (endTime < notes.end[idx]) break;  // The note continues past this timestep
 		// Check if we got a star
-		if ((m_scoreIt->type == Note::NORMAL || m_scoreIt->type == Note::SLIDE || m_scoreIt->type == Note::GOLDEN)
-		  && (m_noteScore / m_vocal.m_scoreFactor / m_scoreIt->maxScore() > 0.8)) {
-			m_scoreIt->stars.push_back(m_color);
+		Note::Type const type = Note::Type(notes.type[idx]);
+		if ((type == Note::NORMAL || type == Note::SLIDE || type == Note::GOLDEN)
+		  && (m_noteScore / m_vocal.m_scoreFactor / notes.maxScore(idx) > 0.8)) {
+			m_vocal.states.addStar(idx, m_color);
 		}
 		m_noteScore = 0; // Reset noteScore as we are moving on to the next one
-		m_scoreIt->power = 0.0; // Remove glow
-		++m_scoreIt;
+		power = 0.0f; // Remove glow
+		++m_scoreIdx;
 	}
-	if (m_scoreIt == m_vocal.notes.end()) calcRowRank();
+	if (m_scoreIdx == notes.size()) calcRowRank();
 	m_score = clamp(m_score, 0.0, 1.0);
 }
 
@@ -71,12 +75,9 @@ void Player::calcRowRank() {
 	if (m_maxLineScore == 0) { // Has the maximum already been calculated for this SLEEP?
 		m_prevLineScore = m_lineScore;
 		// Calculate max score of the completed row
-		Notes::const_reverse_iterator maxScoreIt(m_scoreIt);
-		// NOTE: MacOSX needs the following cast to compile correctly
-		// it is related to the fact that OSX default compiler is 4.0.1 that is buggy when not casting
-		while ((maxScoreIt != static_cast<Notes::const_reverse_iterator>(m_vocal.notes.rend())) && (maxScoreIt->type != Note::SLEEP)) {
-			m_maxLineScore += m_vocal.m_scoreFactor * maxScoreIt->maxScore();
-			maxScoreIt++;
+		NoteTimeline const& notes = m_vocal.timeline;
+		for (std::size_t i = m_scoreIdx; i > 0 && !notes.sleep(i - 1); --i) {
+			m_maxLineScore += m_vocal.m_scoreFactor * notes.maxScore(i - 1);
 		}
 		if (m_maxLineScore > 0) {
 			m_prevLineScore /= m_maxLineScore;
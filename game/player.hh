@@ -39,8 +39,8 @@ struct Player {
 	AnimValue m_feedbackFader;
 	/// activity timer
 	unsigned m_activitytimer;
-	/// score iterator
-	Notes::const_iterator m_scoreIt;
+	/// index of the note being scored (in m_vocal.timeline)
+	std::size_t m_scoreIdx;
 	/// constructor
 	Player(VocalTrack& vocal, Analyzer& analyzer, size_t frames);
 	/// prepares analyzer
@@ -14,6 +14,8 @@
 
 Players::Players():
 	m_players(),
+	m_names(),
+	m_added(),
 	m_filtered(),
 	m_filter(),
 	math_cover(),
@@ -62,11 +64,8 @@ void Players::update() {
 }
 
 int Players::lookup(std::string const& name) const {
-	for (players_t::const_iterator it = m_players.begin(); it != m_players.end(); ++it) {
-		if (it->name == name) return it->id;
-	}
-
-	return -1;
+	names_t::const_iterator it = m_names.find(name);
+	return it == m_names.end() ? -1 : it->second;
 }
 
 std::string Players::lookup(int id) const {
@@ -102,8 +101,11 @@ void Players::addPlayer (std::string const& name, std::string const& picture, in
 	if (!ret.second)
 	{
 		pi.id = assign_id_internal();
-		m_players.insert(pi); // now do the insert with the fresh id
+		ret = m_players.insert(pi); // now do the insert with the fresh id
 	}
+	m_added.push_back(ret.first);
+	std::pair<names_t::iterator, bool> idx = m_names.insert(std::make_pair(pi.name, pi.id));
+	if (!idx.second && pi.id < idx.first->second) idx.first->second = pi.id;
 }
 
 void Players::setFilter(std::string const& val) {
@@ -7,6 +7,7 @@
 #include <stdexcept>
 
 #include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "fs.hh"
 #include "player.hh"
@@ -38,9 +39,12 @@ class Players: boost::noncopyable {
   private:
 	typedef std::set<PlayerItem> players_t;
 	typedef std::vector<PlayerItem> fplayers_t;
+	typedef boost::unordered_map<std::string, int> names_t;
 
   private:
 	players_t m_players;
+	names_t m_names; ///< Player name to the lowest id with that name
+	std::vector<players_t::const_iterator> m_added; ///< All players in the order they were added
 	fplayers_t m_filtered;
 
 	std::string m_filter;
@@ -67,6 +71,10 @@ class Players: boost::noncopyable {
 
 	/// add a player with a displayed name and an optional picture; if no id is given one will be assigned
 	void addPlayer (std::string const& name, std::string const& picture = "", int id = -1);
+	/// number of players added (loaded or new), for journaling
+	std::size_t addedCount() const { return m_added.size(); }
+	/// players in the order they were added
+	PlayerItem const& added(std::size_t pos) const { return *m_added[pos]; }
 
 	/// const array access
 	PlayerItem operator[](std::size_t pos) const {
@@ -152,7 +152,7 @@ void ScreenIntro::draw() {
 
 SvgTxtTheme& ScreenIntro::getTextObject(std::string const& txt) {
 	if (theme->options.contains(txt)) return theme->options[txt];
-	return *theme->options.insert(txt, new SvgTxtTheme(getThemePath("mainmenu_option.svg"), config["graphic/text_lod"].f()))->second;
+	return theme->options.insert(txt, new SvgTxtTheme(getThemePath("mainmenu_option.svg"), config["graphic/text_lod"].f()));
 }
 
 void ScreenIntro::populateMenu() {
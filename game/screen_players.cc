@@ -94,6 +94,7 @@ void ScreenPlayers::manageEvent(SDL_Event event) {
 }
 
 void ScreenPlayers::draw() {
+	glutil::flushSprites();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	m_players.update(); // Poll for new players
 	double length = m_audio.getLength();
@@ -171,7 +172,7 @@ void ScreenPlayers::draw() {
 	if (music != m_playing && m_playTimer.get() > 0.4) {
 		m_songbg.reset(); m_video.reset();
 		if (music.empty()) m_audio.fadeout(1.0); else m_audio.playMusic(music, true, 2.0);
-		if (!songbg.empty()) try { m_songbg.reset(new Surface(songbg)); } catch (std::exception const&) {}
+		if (!songbg.empty()) try { m_songbg.reset(new Surface(songbg, LOAD_BACKGROUND)); } catch (std::exception const&) {}
 		if (!video.empty() && config["graphic/video"].b()) m_video.reset(new Video(video, videoGap));
 		m_playing = music;
 	}
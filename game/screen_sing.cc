@@ -12,6 +12,7 @@
 #include "i18n.hh"
 #include "menu.hh"
 
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <iostream>
@@ -155,6 +156,7 @@ void ScreenSing::createPauseMenu() {
 }
 
 void ScreenSing::reloadGL() {
+	m_bgLayer.invalidate();
 	// Load UI graphics
 	theme.reset(new ThemeSing());
 	m_menuTheme.reset(new ThemeInstrumentMenu());
@@ -162,7 +164,7 @@ void ScreenSing::reloadGL() {
 	m_help.reset(new Surface(getThemePath("instrumenthelp.svg")));
 	m_progress.reset(new ProgressBar(getThemePath("sing_progressbg.svg"), getThemePath("sing_progressfg.svg"), ProgressBar::HORIZONTAL, 0.01f, 0.01f, true));
 	// Load background
-	if (!m_song->background.empty()) m_background.reset(new Surface(m_song->path + m_song->background));
+	if (!m_song->background.empty()) m_background.reset(new Surface(m_song->path + m_song->background, LOAD_BACKGROUND));
 }
 
 void ScreenSing::exit() {
@@ -437,6 +439,12 @@ void ScreenSing::prepare() {
 	if (m_video) m_video->prepare(time);
 }
 
+void ScreenSing::drawBackground(bool fill) {
+	Transform ft(farTransform());
+	if (fill) fillBG();  // Fill white background to avoid black borders
+	m_background->draw();
+}
+
 void ScreenSing::draw() {
 	// Get the time in the song
 	double length = m_audio.getLength();
@@ -460,13 +468,13 @@ void ScreenSing::draw() {
 
 	// Rendering starts
 	{
-		Transform ft(farTransform());
 		double ar = arMax;
 		// Background image
-		if (!m_background || m_background->empty()) m_background.reset(new Surface(m_backgrounds.getRandom()));
+		if (!m_background || m_background->empty()) m_background.reset(new Surface(m_backgrounds.getRandom(), LOAD_BACKGROUND));
 		ar = m_background->dimensions.ar();
-		if (ar > arMax || (m_video && ar > arMin)) fillBG();  // Fill white background to avoid black borders
-		m_background->draw();
+		bool fill = ar > arMax || (m_video && ar > arMin);
+		m_bgLayer.draw(boost::bind(&ScreenSing::drawBackground, this, fill), (boost::format("%1% %2%") % m_background.get() % fill).str());
+		Transform ft(farTransform());
 		// Webcam
 		if (m_cam && config["graphic/webcam"].b()) m_cam->render();
 		// Video
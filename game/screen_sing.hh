@@ -7,6 +7,7 @@
 #include "animvalue.hh"
 #include "engine.hh"
 #include "instrumentgraph.hh"
+#include "layer.hh"
 #include "screen.hh"
 #include "backgrounds.hh"
 #include "theme.hh"
@@ -78,6 +79,7 @@ class ScreenSing: public Screen {
 	void danceLayout(double time);
 	void createPauseMenu();
 	void drawMenu();
+	void drawBackground(bool fill); ///< background image (cached in m_bgLayer)
 	Audio& m_audio;
 	Database& m_database;
 	Backgrounds& m_backgrounds;
@@ -85,6 +87,7 @@ class ScreenSing: public Screen {
 	boost::scoped_ptr<ScoreWindow> m_score_window;
 	boost::scoped_ptr<ProgressBar> m_progress;
 	boost::scoped_ptr<Surface> m_background;
+	Layer m_bgLayer;
 	boost::scoped_ptr<Video> m_video;
 	boost::scoped_ptr<Webcam> m_cam;
 	boost::scoped_ptr<Surface> m_pause_icon;
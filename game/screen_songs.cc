@@ -9,12 +9,17 @@
 #include "i18n.hh"
 #include <iostream>
 #include <sstream>
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 
 static const double IDLE_TIMEOUT = 45.0; // seconds
 
+namespace {
+	std::size_t coverBytes(Thumbnail const& cover) { return cover.bytes(); }
+}
+
 ScreenSongs::ScreenSongs(std::string const& name, Audio& audio, Songs& songs, Database& database):
-  Screen(name), m_audio(audio), m_songs(songs), m_database(database), m_covers(20), m_jukebox(), show_hiscores(), hiscore_start_pos()
+  Screen(name), m_audio(audio), m_songs(songs), m_database(database), m_covers(64 << 20, coverBytes), m_jukebox(), show_hiscores(), hiscore_start_pos()
 {
 	m_songs.setAnimMargins(5.0, 5.0);
 	m_idleTimer.setTarget(getInf()); // Using this as a simple timer counting seconds
@@ -26,10 +31,13 @@ void ScreenSongs::enter() {
 	m_jukebox = false;
 	show_hiscores = false;
 	hiscore_start_pos = 0;
+	m_covers.budget(config["graphic/cover_cache"].i() << 20);
 	reloadGL();
 }
 
 void ScreenSongs::reloadGL() {
+	m_bgLayer.invalidate();
+	m_groundLayer.invalidate();
 	theme.reset(new ThemeSongs());
 	m_songbg_default.reset(new Surface(getThemePath("songs_bg_default.svg")));
 	m_songbg_ground.reset(new Surface(getThemePath("songs_bg_ground.svg")));
@@ -41,6 +49,8 @@ void ScreenSongs::reloadGL() {
 }
 
 void ScreenSongs::exit() {
+	std::clog << "cache/debug: Covers: " << m_covers.size() << " covers, " << (m_covers.cost() >> 20) << " MB, "
+	  << m_covers.hits() << " hits, " << m_covers.misses() << " misses, " << m_covers.evictions() << " evictions" << std::endl;
 	m_covers.clear();
 	m_singCover.reset();
 	m_instrumentCover.reset();
@@ -53,6 +63,7 @@ void ScreenSongs::exit() {
 	m_songbg_default.reset();
 	m_songbg_ground.reset();
 	m_playing.clear();
+	m_preload.cancel();
 }
 
 /**Add actions here which should effect both the
@@ -64,7 +75,10 @@ void ScreenSongs::manageSharedKey(input::NavButton nav) {
 		Screen* s = sm->getScreen("Sing");
 		ScreenSing* ss = dynamic_cast<ScreenSing*> (s);
 		assert(ss);
-		ss->setSong(m_songs.currentPtr());
+		boost::shared_ptr<Song> song = m_songs.currentPtr();
+		boost::shared_ptr<Song> prepared;
+		if (song) prepared = m_preload.take(*song);  // Fully loaded already, if the user waited long enough
+		ss->setSong(prepared ? prepared : song);
 		sm->activateScreen("Sing");
 	}
 	else if (nav == input::LEFT) { m_songs.advance(-1); hiscore_start_pos = 0; }
@@ -153,6 +167,8 @@ void ScreenSongs::update() {
 	// Switch songs if needed, only when the user is not browsing for a moment
 	if (!songChange) return;
 	m_playing = music;
+	// The selection has settled, prepare the song for singing
+	if (song) m_preload.request(*song); else m_preload.cancel();
 	// Clear the old content and load new content if available
 	m_songbg.reset(); m_video.reset();
 	double pstart = (!m_jukebox && song ? song->preview_start : 0.0);
@@ -160,7 +176,7 @@ void ScreenSongs::update() {
 	if (song) {
 		std::string background = song->background;
 		std::string video = song->video;
-		if (!background.empty()) try { m_songbg.reset(new Surface(song->path + background)); } catch (std::exception const&) {}
+		if (!background.empty()) try { m_songbg.reset(new Surface(song->path + background, LOAD_BACKGROUND)); } catch (std::exception const&) {}
 		if (!video.empty() && config["graphic/video"].b()) m_video.reset(new Video(song->path + video, song->videoGap));
 	}
 }
@@ -192,37 +208,48 @@ void ScreenSongs::drawJukebox() {
 	}
 }
 
+void ScreenSongs::drawBackground() {
+	Transform ft(farTransform());  // 3D effect
+	Song& song = m_songs.current();
+	m_songbg_default->draw();   // Default bg
+	if (m_songbg.get()) m_songbg->draw();
+	else if (!song.cover.empty()) {
+		// Create a background image by tiling covers
+		try {
+			Surface& cover = m_covers[song.path + song.cover];
+			Dimensions backup = cover.dimensions;
+			const float s = 0.3;
+			cover.dimensions.fixedWidth(s).screenTop(0.0);
+			cover.dimensions.top(0.0).right(-s); cover.draw();
+			cover.dimensions.top(0.0).right(0.0); cover.draw();
+			cover.dimensions.top(0.0).left(0.0); cover.draw();
+			cover.dimensions.top(0.0).left(s); cover.draw();
+			cover.dimensions.top(s).right(-s); cover.draw();
+			cover.dimensions.top(s).right(0.0); cover.draw();
+			cover.dimensions.top(s).left(0.0); cover.draw();
+			cover.dimensions.top(s).left(s); cover.draw();
+			cover.dimensions = backup;
+		} catch (std::exception const&) {}
+	}
+}
+
+void ScreenSongs::drawGround() {
+	m_songbg_ground->draw();
+	theme->bg.draw();
+}
+
 void ScreenSongs::drawMultimedia() {
 	{
+		Song& song = m_songs.current();
+		// The background changes with the song (cover tiles) and when its own background gets selected
+		m_bgLayer.draw(boost::bind(&ScreenSongs::drawBackground, this), (boost::format("%1% %2%") % m_songbg.get() % (song.path + song.cover)).str());
 		Transform ft(farTransform());  // 3D effect
 		double length = m_audio.getLength();
 		double time = clamp(m_audio.getPosition() - config["audio/video_delay"].f(), 0.0, length);
-		Song& song = m_songs.current();
-		m_songbg_default->draw();   // Default bg
-		if (m_songbg.get()) m_songbg->draw();
-		else if (!song.cover.empty()) {
-			// Create a background image by tiling covers
-			try {
-				Surface& cover = m_covers[song.path + song.cover];
-				Dimensions backup = cover.dimensions;
-				const float s = 0.3;
-				cover.dimensions.fixedWidth(s).screenTop(0.0);
-				cover.dimensions.top(0.0).right(-s); cover.draw();
-				cover.dimensions.top(0.0).right(0.0); cover.draw();
-				cover.dimensions.top(0.0).left(0.0); cover.draw();
-				cover.dimensions.top(0.0).left(s); cover.draw();
-				cover.dimensions.top(s).right(-s); cover.draw();
-				cover.dimensions.top(s).right(0.0); cover.draw();
-				cover.dimensions.top(s).left(0.0); cover.draw();
-				cover.dimensions.top(s).left(s); cover.draw();
-				cover.dimensions = backup;
-			} catch (std::exception const&) {}
-		}
 		if (m_video.get()) m_video->render(time);
 	}
 	if (!m_jukebox) {
-		m_songbg_ground->draw();
-		theme->bg.draw();
+		m_groundLayer.draw(boost::bind(&ScreenSongs::drawGround, this));
 		drawCovers();
 	}
 }
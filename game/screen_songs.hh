@@ -4,7 +4,9 @@
 #include "animvalue.hh"
 #include "cachemap.hh"
 #include "database.hh"
+#include "layer.hh"
 #include "screen.hh"
+#include "songpreload.hh"
 #include "surface.hh"
 #include "textinput.hh"
 #include "theme.hh"
@@ -34,12 +36,15 @@ public:
 protected:
 	void drawInstruments(Dimensions const& dim, float alpha = 1.0f) const;
 	void drawMultimedia();
+	void drawBackground(); ///< default, song or cover background (cached in m_bgLayer)
+	void drawGround(); ///< theme graphics over the video (cached in m_groundLayer)
 	void update();
 
 	Audio& m_audio;
 	Songs& m_songs;
 	Database& m_database;
 	boost::scoped_ptr<Surface> m_songbg, m_songbg_ground, m_songbg_default;
+	Layer m_bgLayer, m_groundLayer;
 	boost::scoped_ptr<Video> m_video;
 	boost::scoped_ptr<ThemeSongs> theme;
 	Song::Music m_playing;
@@ -50,7 +55,8 @@ protected:
 	boost::scoped_ptr<Surface> m_bandCover;
 	boost::scoped_ptr<Surface> m_danceCover;
 	boost::scoped_ptr<Texture> m_instrumentList;
-	Cachemap<std::string, Surface> m_covers;
+	Cachemap<std::string, Thumbnail> m_covers;
+	SongPreload m_preload; ///< Prepares the selected song for ScreenSing
 	bool m_jukebox;
 	bool show_hiscores;
 	int hiscore_start_pos;
@@ -0,0 +1,111 @@
+#include "searchindex.hh"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+	bool isSpace(char ch) { return ch == ' ' || ch == '\t' || ch == '\n'; }
+
+	std::vector<std::string> split(std::string const& query) {
+		std::vector<std::string> words;
+		for (std::string::const_iterator it = query.begin(); it != query.end();) {
+			std::string::const_iterator end = std::find_if(it, query.end(), isSpace);
+			if (end != it) words.push_back(std::string(it, end));
+			it = (end == query.end() ? end : end + 1);
+		}
+		return words;
+	}
+
+	boost::uint32_t trigram(char const* p) {
+		unsigned char const* u = reinterpret_cast<unsigned char const*>(p);
+		return u[0] << 16 | u[1] << 8 | u[2];
+	}
+
+	bool shorter(SearchIndex::Results const* a, SearchIndex::Results const* b) { return a->size() < b->size(); }
+}
+
+void SearchIndex::clear() {
+	m_buffer.clear();
+	m_offsets.assign(1, 0);
+	m_trigrams.clear();
+	m_query.clear();
+	m_querySize = 0;
+	m_results.clear();
+}
+
+void SearchIndex::add(std::string const& key) {
+	unsigned doc = size();
+	m_buffer += key;
+	m_offsets.push_back(m_buffer.size());
+	for (std::size_t i = 0; i + 3 <= key.size(); ++i) {
+		if (isSpace(key[i]) || isSpace(key[i + 1]) || isSpace(key[i + 2])) continue;  // Words never contain these
+		Results& docs = m_trigrams[trigram(&key[i])];
+		if (docs.empty() || docs.back() != doc) docs.push_back(doc);
+	}
+}
+
+bool SearchIndex::contains(unsigned doc, std::string const& word) const {
+	std::string::const_iterator b = m_buffer.begin() + m_offsets[doc], e = m_buffer.begin() + m_offsets[doc + 1];
+	return std::search(b, e, word.begin(), word.end()) != e;
+}
+
+SearchIndex::Results const& SearchIndex::find(std::string const& query) {
+	if (query == m_query && m_querySize == size()) return m_results;
+	std::vector<std::string> words = split(query);
+	// Candidate documents: all or, if the query only got longer, the previous results plus new documents
+	bool all = true;
+	Results candidates;
+	if (!m_query.empty() && query.compare(0, m_query.size(), m_query) == 0) {
+		all = false;
+		candidates.swap(m_results);
+		for (unsigned doc = m_querySize; doc < size(); ++doc) candidates.push_back(doc);
+	}
+	// Narrow down by the trigrams of each word, starting from the rarest
+	std::vector<Results const*> lists;
+	static const Results empty;
+	for (std::size_t w = 0; w < words.size(); ++w) {
+		std::string const& word = words[w];
+		for (std::size_t i = 0; i + 3 <= word.size(); ++i) {
+			Trigrams::const_iterator it = m_trigrams.find(trigram(&word[i]));
+			lists.push_back(it == m_trigrams.end() ? &empty : &it->second);
+		}
+	}
+	std::sort(lists.begin(), lists.end(), shorter);
+	for (std::size_t i = 0; i < lists.size(); ++i) {
+		if (all) { candidates = *lists[i]; all = false; continue; }
+		Results tmp;
+		std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(tmp));
+		candidates.swap(tmp);
+		if (candidates.empty()) break;
+	}
+	if (all) {
+		candidates.resize(size());
+		for (unsigned doc = 0; doc < size(); ++doc) candidates[doc] = doc;
+	}
+	// Verify the candidates (trigrams may appear in a different order or be split across words)
+	m_results.clear();
+	for (Results::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+		std::size_t w = 0;
+		while (w < words.size() && contains(*it, words[w])) ++w;
+		if (w == words.size()) m_results.push_back(*it);
+	}
+	m_query = query;
+	m_querySize = size();
+	return m_results;
+}
+
+bool SearchIndex::match(unsigned doc, std::string const& query) const {
+	std::vector<std::string> words = split(query);
+	for (std::size_t w = 0; w < words.size(); ++w) if (!contains(doc, words[w])) return false;
+	return true;
+}
+
+void SearchIndex::swap(SearchIndex& other) {
+	m_buffer.swap(other.m_buffer);
+	m_offsets.swap(other.m_offsets);
+	m_trigrams.swap(other.m_trigrams);
+	m_query.swap(other.m_query);
+	std::swap(m_querySize, other.m_querySize);
+	m_results.swap(other.m_results);
+}
+
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <vector>
+
+/**
+* @short Substring search over a set of texts (the song browser search).
+* Texts are stored in search key form (see unicodeSearchKey) in one contiguous buffer,
+* with a trigram index for finding candidates quickly. A query matches texts that contain
+* all of its words. Typing more characters only searches among the previous results.
+**/
+class SearchIndex {
+  public:
+	typedef std::vector<unsigned> Results; ///< Document numbers in ascending order
+	SearchIndex() { clear(); }
+	/// Remove all documents
+	void clear();
+	/// Add a document (already in search key form), documents are numbered in the order they are added
+	void add(std::string const& key);
+	/// Number of documents
+	unsigned size() const { return m_offsets.size() - 1; }
+	/// Find the documents matching a query (in search key form)
+	Results const& find(std::string const& query);
+	/// Test a single document against a query (in search key form)
+	bool match(unsigned doc, std::string const& query) const;
+	/// Swap contents
+	void swap(SearchIndex& other);
+  private:
+	typedef boost::uint32_t Trigram;
+	typedef boost::unordered_map<Trigram, Results> Trigrams;
+	bool contains(unsigned doc, std::string const& word) const;
+	std::string m_buffer; ///< All documents, back to back
+	std::vector<unsigned> m_offsets; ///< Start of each document in m_buffer (plus end of the last one)
+	Trigrams m_trigrams; ///< Documents containing each trigram
+	// Previous query, used for narrowing the search
+	std::string m_query;
+	unsigned m_querySize; ///< Number of documents when the previous query was done
+	Results m_results;
+};
+
@@ -6,6 +6,12 @@
 #include <algorithm>
 
 void Song::reload(bool errorIgnore) {
+	clear();
+	try { SongParser(*this); } catch (...) { if (!errorIgnore) throw; }
+	collateUpdate();
+}
+
+void Song::clear() {
 	loadStatus = NONE;
 	vocalTracks.clear();
 	instrumentTracks.clear();
@@ -31,8 +37,6 @@ void Song::reload(bool errorIgnore) {
 	preview_start = getNaN();
 	hasBRE = false;
 	b0rkedTracks = false;
-	try { SongParser(*this); } catch (...) { if (!errorIgnore) throw; }
-	collateUpdate();
 }
 
 void Song::dropNotes() {
@@ -3,6 +3,7 @@
 #include "notes.hh"
 #include "i18n.hh"
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 
 #include <stdexcept>
@@ -20,6 +21,8 @@ struct SongParserException: public std::runtime_error {
 };
 
 class SongParser;
+class SongIndex;
+struct SongTimelines;
 
 namespace TrackName {
 	const std::string GUITAR = "Guitar";
@@ -37,6 +40,8 @@ namespace TrackName {
 /// class to load and parse songfiles
 class Song: boost::noncopyable {
 	friend class SongParser;
+	friend class SongIndex;
+	friend class Songs;
   public:
 	VocalTracks vocalTracks; ///< notes for the sing part
 	VocalTrack dummyVocal; ///< notes for the sing part
@@ -88,6 +93,7 @@ class Song: boost::noncopyable {
 
 	InstrumentTracks instrumentTracks; ///< guitar etc. notes for this song
 	DanceTracks danceTracks; ///< dance tracks
+	boost::shared_ptr<SongTimelines const> timelines; ///< timelines for the graphs, if prepared by SongPreload
 	bool hasDance() const { return !danceTracks.empty(); }
 	bool hasDrums() const { return instrumentTracks.find(TrackName::DRUMS) != instrumentTracks.end(); }
 	bool hasKeyboard() const { return instrumentTracks.find(TrackName::KEYBOARD) != instrumentTracks.end(); }
@@ -138,6 +144,12 @@ class Song: boost::noncopyable {
 	SongSections songsections; ///< vector of song sections
 	bool getNextSection(double pos, SongSection &section);
 	bool getPrevSection(double pos, SongSection &section);
+  private:
+	struct Restored {};
+	/// constructor for songs restored without parsing (header fields are filled in by the caller)
+	Song(std::string const& path_, std::string const& filename_, Restored): dummyVocal(TrackName::LEAD_VOCAL), path(path_), filename(filename_) { clear(); }
+	/// reset all song data to defaults
+	void clear();
 };
 
 static inline bool operator<(Song const& l, Song const& r) { return l.collateByArtist < r.collateByArtist; }
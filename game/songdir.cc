@@ -0,0 +1,112 @@
+#include "songdir.hh"
+
+#include "fs.hh"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+
+namespace {
+	boost::mutex cacheMutex;
+	unsigned scans = 0;  ///< Number of active SongDir::Scan objects
+	typedef std::map<std::string, boost::shared_ptr<SongDir const> > Cache;
+	Cache cache;
+
+	std::string toLower(std::string str) {
+		for (std::string::iterator it = str.begin(); it != str.end(); ++it) if (*it >= 'A' && *it <= 'Z') *it += 'a' - 'A';
+		return str;
+	}
+}
+
+SongDir::Rules& SongDir::Rules::add(Match match, std::string const& pattern, unsigned kind) {
+	Map& map = (match == EXACT ? m_exact : match == PREFIX ? m_prefix : m_suffix);
+	map.insert(Map::value_type(toLower(pattern), kind));  // Does not replace an earlier rule for the same pattern
+	m_kinds = std::max(m_kinds, kind + 1);
+	return *this;
+}
+
+int SongDir::Rules::classify(std::string const& name) const {
+	return classifyLower(toLower(name));
+}
+
+int SongDir::Rules::classifyLower(std::string const& lower) const {
+	Map::const_iterator it = m_exact.find(lower);
+	if (it != m_exact.end()) return it->second;
+	std::string::size_type pos = lower.find('.');
+	if (pos != std::string::npos && !m_prefix.empty()) {
+		it = m_prefix.find(lower.substr(0, pos));
+		if (it != m_prefix.end()) return it->second;
+	}
+	pos = lower.rfind('.');
+	if (pos != std::string::npos && !m_suffix.empty()) {
+		it = m_suffix.find(lower.substr(pos + 1));
+		if (it != m_suffix.end()) return it->second;
+	}
+	return -1;
+}
+
+SongDir::Scan::Scan() {
+	boost::mutex::scoped_lock l(cacheMutex);
+	++scans;
+}
+
+SongDir::Scan::~Scan() {
+	boost::mutex::scoped_lock l(cacheMutex);
+	if (--scans == 0) cache.clear();
+}
+
+boost::shared_ptr<SongDir const> SongDir::get(std::string const& path) {
+	{
+		boost::mutex::scoped_lock l(cacheMutex);
+		Cache::const_iterator it = cache.find(path);
+		if (it != cache.end()) return it->second;
+	}
+	// List without holding the lock (another thread may list the same folder meanwhile, that is harmless)
+	boost::shared_ptr<SongDir const> dir(new SongDir(path));
+	boost::mutex::scoped_lock l(cacheMutex);
+	if (scans > 0) cache.insert(Cache::value_type(path, dir));
+	return dir;
+}
+
+void SongDir::put(std::string const& path, std::vector<std::string> const& names) {
+	boost::mutex::scoped_lock l(cacheMutex);
+	if (scans == 0) return;
+	cache[path].reset(new SongDir(path, names));
+}
+
+SongDir::SongDir(std::string const& path): m_path(path) {
+	for (fs::directory_iterator dirIt(path), dirEnd; dirIt != dirEnd; ++dirIt) {
+#if BOOST_FILESYSTEM_VERSION < 3
+		add(dirIt->path().leaf());
+#else
+		add(dirIt->path().filename().string());
+#endif
+	}
+}
+
+SongDir::SongDir(std::string const& path, std::vector<std::string> const& names): m_path(path) {
+	for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) add(*it);
+}
+
+void SongDir::add(std::string const& name) {
+	Entry e;
+	e.name = name;
+	e.lower = toLower(name);
+	m_entries.push_back(e);
+	m_names.insert(name);
+}
+
+bool SongDir::exists(std::string const& name) const {
+	if (name.empty()) return false;
+	if (m_names.find(name) != m_names.end()) return true;
+	// Not listed as such: names in other case (case-insensitive filesystems) and in subfolders (either separator)
+	return fs::exists(m_path + name);
+}
+
+std::vector<std::string> SongDir::find(Rules const& rules) const {
+	std::vector<std::string> found(rules.kinds());
+	for (std::vector<Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+		int kind = rules.classifyLower(it->lower);
+		if (kind >= 0 && found[kind].empty()) found[kind] = it->name;
+	}
+	return found;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <string>
+#include <vector>
+
+/**
+* @short Listing of a song folder, for finding covers, backgrounds, audio tracks etc.
+* While a SongDir::Scan is alive (during song scanning) each folder is listed only once and
+* the listing is shared by all song files in it, instead of probing the filesystem repeatedly.
+**/
+class SongDir: boost::noncopyable {
+  public:
+	/// Table for classifying file names (case-insensitive, without regular expressions)
+	class Rules {
+	  public:
+		Rules(): m_kinds() {}
+		/// What part of the name is compared: all of it, the part before the first dot or the extension after the last dot
+		enum Match { EXACT, PREFIX, SUFFIX };
+		/// Add a rule (whole names are matched first, then prefixes, then extensions)
+		Rules& add(Match match, std::string const& pattern, unsigned kind);
+		/// Number of kinds used
+		unsigned kinds() const { return m_kinds; }
+		/// Classify a file name, returns -1 for no match
+		int classify(std::string const& name) const;
+	  private:
+		friend class SongDir;
+		int classifyLower(std::string const& lower) const;
+		typedef boost::unordered_map<std::string, unsigned> Map;
+		Map m_exact, m_prefix, m_suffix;
+		unsigned m_kinds;
+	};
+	/// Cache listings for the lifetime of this object
+	class Scan: boost::noncopyable {
+	  public:
+		Scan();
+		~Scan();
+	};
+	/// Get the listing of a folder (path with a trailing slash, as in Song::path), throws if it cannot be read
+	static boost::shared_ptr<SongDir const> get(std::string const& path);
+	/// Cache a listing obtained elsewhere (by the song scan itself), ignored if no scan is active
+	static void put(std::string const& path, std::vector<std::string> const& names);
+	/// Check if a file exists (names not found in the listing are checked from the filesystem)
+	bool exists(std::string const& name) const;
+	/// Find the first file name of each kind (an empty string if there is none)
+	std::vector<std::string> find(Rules const& rules) const;
+  private:
+	explicit SongDir(std::string const& path);
+	SongDir(std::string const& path, std::vector<std::string> const& names);
+	void add(std::string const& name);
+	struct Entry {
+		std::string name;
+		std::string lower; ///< Name in lower case for classification
+	};
+	std::string m_path;
+	std::vector<Entry> m_entries;
+	boost::unordered_set<std::string> m_names;
+};
@@ -0,0 +1,205 @@
+#include "songindex.hh"
+
+#include "song.hh"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	const char MAGIC[4] = { 'P', 'S', 'I', 'X' };
+	/// Bump this whenever the record layout or the header parsing changes (invalidates old indexes)
+	const boost::uint32_t VERSION = 1;
+
+	/// Serializes values into a byte string (native byte order; the index is a local cache only)
+	class Writer {
+		std::string& m_buf;
+	  public:
+		Writer(std::string& buf): m_buf(buf) {}
+		template <typename T> void pod(T val) { m_buf.append(reinterpret_cast<char const*>(&val), sizeof(val)); }
+		void str(std::string const& s) { pod(boost::uint32_t(s.size())); m_buf += s; }
+	};
+
+	/// Bounds-checked reader for the data written by Writer
+	class Reader {
+		char const* m_pos;
+		char const* m_end;
+		void need(size_t bytes) const { if (size_t(m_end - m_pos) < bytes) throw std::runtime_error("Song index truncated"); }
+	  public:
+		Reader(char const* begin, char const* end): m_pos(begin), m_end(end) {}
+		bool eof() const { return m_pos == m_end; }
+		char const* pos() const { return m_pos; }
+		void skip(size_t bytes) { need(bytes); m_pos += bytes; }
+		template <typename T> T pod() { T val; need(sizeof(val)); std::memcpy(&val, m_pos, sizeof(val)); m_pos += sizeof(val); return val; }
+		std::string str() { boost::uint32_t size = pod<boost::uint32_t>(); need(size); std::string s(m_pos, size); m_pos += size; return s; }
+	};
+
+	void writeRecord(std::string& buf, SongIndex::Stamp const& stamp, std::string const& payload) {
+		Writer w(buf);
+		w.pod(boost::int64_t(stamp.mtime));
+		w.pod(boost::uint64_t(stamp.size));
+		w.str(payload);
+	}
+}
+
+SongIndex::SongIndex(fs::path const& filename): m_filename(filename), m_hits() {
+	try {
+		if (!fs::exists(filename)) return;
+		m_file.open(filename.string());
+		Reader r(m_file.begin(), m_file.end());
+		r.skip(sizeof(MAGIC));
+		if (std::memcmp(m_file.data(), MAGIC, sizeof(MAGIC)) || r.pod<boost::uint32_t>() != VERSION) {
+			std::clog << "songindex/info: Ignoring outdated song index " << filename << std::endl;
+			m_file.close();
+			return;
+		}
+		while (!r.eof()) {
+			std::string key = r.str();
+			Entry& e = m_entries[key];
+			e.stamp.mtime = r.pod<boost::int64_t>();
+			e.stamp.size = r.pod<boost::uint64_t>();
+			e.size = r.pod<boost::uint32_t>();
+			e.data = r.pos();
+			r.skip(e.size);
+		}
+	} catch (std::exception& e) {
+		std::clog << "songindex/warning: Song index " << filename << " not loaded: " << e.what() << std::endl;
+		m_entries.clear();
+		m_file.close();
+	}
+}
+
+bool SongIndex::get(std::string const& key, std::string const& path, std::string const& filename, Entry const& e, boost::shared_ptr<Song>& song) const {
+	try {
+		if (e.size == 0) song.reset();  // Known not to be a song
+		else {
+			song.reset(new Song(path, filename, Song::Restored()));
+			restore(*song, e.data, e.size);
+		}
+	} catch (std::exception& ex) {
+		std::clog << "songindex/warning: Corrupted entry for " << key << ": " << ex.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SongIndex::lookup(std::string const& path, std::string const& filename, Stamp const& stamp, boost::shared_ptr<Song>& song) {
+	std::string key = path + filename;
+	boost::mutex::scoped_lock l(m_mutex);
+	Entries::const_iterator it = m_entries.find(key);
+	if (it == m_entries.end() || !(it->second.stamp == stamp)) return false;
+	Entry const& e = it->second;
+	if (!get(key, path, filename, e, song)) return false;
+	std::string& rec = m_records[key];
+	rec.clear();  // A repeated lookup must not duplicate the record
+	writeRecord(rec, stamp, std::string(e.data, e.size));
+	++m_hits;
+	return true;
+}
+
+bool SongIndex::restore(std::string const& path, std::string const& filename, boost::shared_ptr<Song>& song) {
+	std::string key = path + filename;
+	boost::mutex::scoped_lock l(m_mutex);
+	Entries::const_iterator it = m_entries.find(key);
+	return it != m_entries.end() && get(key, path, filename, it->second, song);
+}
+
+void SongIndex::store(std::string const& path, std::string const& filename, Stamp const& stamp, Song const* song) {
+	std::string payload;
+	if (song) {
+		Song const& s = *song;
+		Writer w(payload);
+		w.str(s.title); w.str(s.artist); w.str(s.edition); w.str(s.genre);
+		w.str(s.creator); w.str(s.language); w.str(s.text); w.str(s.midifilename);
+		w.str(s.cover); w.str(s.background); w.str(s.video);
+		w.str(s.collateByTitle); w.str(s.collateByTitleOnly); w.str(s.collateByArtist); w.str(s.collateByArtistOnly);
+		w.pod(s.videoGap); w.pod(s.start); w.pod(s.preview_start);
+		w.pod(boost::uint8_t(s.hasBRE));
+		w.pod(boost::uint32_t(s.category.size()));
+		for (size_t i = 0; i < s.category.size(); ++i) w.str(s.category[i]);
+		w.pod(boost::uint32_t(s.music.size()));
+		for (Song::Music::const_iterator it = s.music.begin(); it != s.music.end(); ++it) { w.str(it->first); w.str(it->second); }
+		w.pod(boost::uint32_t(s.stops.size()));
+		for (size_t i = 0; i < s.stops.size(); ++i) { w.pod(s.stops[i].first); w.pod(s.stops[i].second); }
+		// Only the presence of tracks is stored, notes are always loaded from the song file
+		w.pod(boost::uint32_t(s.vocalTracks.size()));
+		for (VocalTracks::const_iterator it = s.vocalTracks.begin(); it != s.vocalTracks.end(); ++it) w.str(it->first);
+		w.pod(boost::uint32_t(s.instrumentTracks.size()));
+		for (InstrumentTracks::const_iterator it = s.instrumentTracks.begin(); it != s.instrumentTracks.end(); ++it) w.str(it->first);
+		w.pod(boost::uint32_t(s.danceTracks.size()));
+		for (DanceTracks::const_iterator it = s.danceTracks.begin(); it != s.danceTracks.end(); ++it) {
+			w.str(it->first);
+			w.pod(boost::uint32_t(it->second.size()));
+			for (DanceDifficultyMap::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+				w.pod(boost::int32_t(it2->first));
+				w.str(it2->second.description);
+			}
+		}
+	}
+	boost::mutex::scoped_lock l(m_mutex);
+	std::string& rec = m_records[path + filename];
+	rec.clear();
+	writeRecord(rec, stamp, payload);
+}
+
+void SongIndex::restore(Song& s, char const* data, boost::uint32_t size) const {
+	Reader r(data, data + size);
+	s.title = r.str(); s.artist = r.str(); s.edition = r.str(); s.genre = r.str();
+	s.creator = r.str(); s.language = r.str(); s.text = r.str(); s.midifilename = r.str();
+	s.cover = r.str(); s.background = r.str(); s.video = r.str();
+	s.collateByTitle = r.str(); s.collateByTitleOnly = r.str(); s.collateByArtist = r.str(); s.collateByArtistOnly = r.str();
+	s.videoGap = r.pod<double>(); s.start = r.pod<double>(); s.preview_start = r.pod<double>();
+	s.hasBRE = r.pod<boost::uint8_t>();
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) s.category.push_back(r.str());
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) { std::string key = r.str(); s.music[key] = r.str(); }
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) {
+		double time = r.pod<double>();
+		s.stops.push_back(std::make_pair(time, r.pod<double>()));
+	}
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) { std::string name = r.str(); s.insertVocalTrack(name, VocalTrack(name)); }
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) { std::string name = r.str(); s.instrumentTracks.insert(std::make_pair(name, InstrumentTrack(name))); }
+	for (boost::uint32_t i = 0, n = r.pod<boost::uint32_t>(); i < n; ++i) {
+		DanceDifficultyMap& difficulties = s.danceTracks[r.str()];
+		for (boost::uint32_t j = 0, m = r.pod<boost::uint32_t>(); j < m; ++j) {
+			DanceDifficulty diff = DanceDifficulty(r.pod<boost::int32_t>());
+			std::string description = r.str();
+			Notes notes;
+			difficulties.insert(std::make_pair(diff, DanceTrack(description, notes)));
+		}
+	}
+	s.loadStatus = Song::HEADER;
+}
+
+void SongIndex::save(bool prune) {
+	boost::mutex::scoped_lock l(m_mutex);
+	fs::path tmp = m_filename.string() + ".tmp";
+	try {
+		fs::create_directories(m_filename.parent_path());
+		{
+			std::ofstream f(tmp.string().c_str(), std::ios::binary);
+			f.write(MAGIC, sizeof(MAGIC));
+			f.write(reinterpret_cast<char const*>(&VERSION), sizeof(VERSION));
+			for (Records::const_iterator it = m_records.begin(); it != m_records.end(); ++it) {
+				std::string key;
+				Writer(key).str(it->first);
+				f << key << it->second;
+			}
+			for (Entries::const_iterator it = m_entries.begin(); !prune && it != m_entries.end(); ++it) {
+				if (m_records.find(it->first) != m_records.end()) continue;  // Already written (possibly updated)
+				std::string rec;
+				Writer(rec).str(it->first);
+				writeRecord(rec, it->second.stamp, std::string(it->second.data, it->second.size));
+				f << rec;
+			}
+			if (!f) throw std::runtime_error("Write error");
+		}
+		// The entries point into the mapping which is about to be replaced
+		m_entries.clear();
+		m_file.close();
+		if (fs::exists(m_filename)) fs::remove(m_filename);  // Windows cannot rename over an existing file
+		fs::rename(tmp, m_filename);
+	} catch (std::exception& e) {
+		std::clog << "songindex/error: Cannot save " << m_filename << ": " << e.what() << std::endl;
+	}
+}
+
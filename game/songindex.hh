@@ -0,0 +1,72 @@
+#pragma once
+
+#include "fs.hh"
+#include "mappedfile.hh"
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ctime>
+#include <map>
+#include <string>
+
+class Song;
+
+/**
+* @short Persistent cache of parsed song headers.
+* Entries are keyed by the song file path and validated against its mtime and size.
+* The index file is memory-mapped on load and each record is only decoded when looked up,
+* so that unchanged songs can be listed without opening or parsing their files.
+* Files that are known not to be songs are remembered too, so that they are not parsed again.
+**/
+class SongIndex: boost::noncopyable {
+  public:
+	/// File timestamp and size, used to detect modified files
+	struct Stamp {
+		std::time_t mtime;
+		boost::uint64_t size;
+		Stamp(): mtime(), size() {}
+		/// Read the stamp of a file
+		explicit Stamp(fs::path const& file): mtime(fs::last_write_time(file)), size(fs::file_size(file)) {}
+		bool operator==(Stamp const& o) const { return mtime == o.mtime && size == o.size; }
+	};
+	/// Load the index from filename (a missing or outdated index is silently ignored)
+	SongIndex(fs::path const& filename);
+	/**
+	* Look up a song file while scanning (the entry is kept for save()).
+	* @return true if a fresh entry was found; song is then set to the restored song or to NULL for non-song files
+	**/
+	bool lookup(std::string const& path, std::string const& filename, Stamp const& stamp, boost::shared_ptr<Song>& song);
+	/**
+	* Restore a song for browsing, as it was when last scanned (the file is not accessed, changes are found by scans).
+	* @return true if an entry was found; song is then set as in lookup
+	**/
+	bool restore(std::string const& path, std::string const& filename, boost::shared_ptr<Song>& song);
+	/// Record a parsed song (or a file that is not a song, if song is NULL)
+	void store(std::string const& path, std::string const& filename, Stamp const& stamp, Song const* song);
+	/**
+	* Write the index to disk.
+	* @param prune if true, only entries looked up or stored since loading are kept (after a full scan,
+	*        this drops files that no longer exist); otherwise the other loaded entries are kept as they were
+	**/
+	void save(bool prune = true);
+	/// Number of lookups that were served from the index
+	unsigned hits() const { return m_hits; }
+  private:
+	struct Entry {
+		Stamp stamp;
+		char const* data;  ///< Record payload within the mapping
+		boost::uint32_t size;
+	};
+	typedef std::map<std::string, Entry> Entries;
+	typedef std::map<std::string, std::string> Records;  ///< Serialized records (stamp + payload), by key
+	bool get(std::string const& key, std::string const& path, std::string const& filename, Entry const& e, boost::shared_ptr<Song>& song) const;
+	void restore(Song& s, char const* data, boost::uint32_t size) const;
+	fs::path m_filename;
+	MappedFile m_file;
+	Entries m_entries;
+	Records m_records;
+	unsigned m_hits;
+	boost::mutex m_mutex;
+};
+
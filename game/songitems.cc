@@ -49,8 +49,12 @@ int SongItems::addSongItem(std::string const& artist, std::string const& title,
 	if (!ret.second)
 	{
 		si.id = assign_id_internal();
-		m_songs.insert(si); // now do the insert with the fresh id
+		ret = m_songs.insert(si); // now do the insert with the fresh id
 	}
+	m_added.push_back(ret.first);
+	// Duplicates may come from the file, lookups find the one with the lowest id
+	std::pair<index_t::iterator, bool> idx = m_index.insert(std::make_pair(key(si.artist, si.title), si.id));
+	if (!idx.second && si.id < idx.first->second) idx.first->second = si.id;
 	return si.id;
 }
 
@@ -65,29 +69,16 @@ void SongItems::addSong(boost::shared_ptr<Song> song) {
 	si.id = id;
 	songs_t::iterator it = m_songs.find(si);
 	if (it == m_songs.end()) throw SongItemsException("Cant find song which was added just before");
-	// it->song.reset(song); // does not work, it is a read only structure...
-
-	// fill up the rest of the information
-	si.artist = it->artist;
-	si.title = it->title;
-	si.song = song;
-
-	m_songs.erase(it);
-	m_songs.insert(si);
+	it->song = song; // fill up the rest of the information
 }
 
 int SongItems::lookup(boost::shared_ptr<Song> song) const {
-	for (songs_t::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) {
-		if (song->collateByArtistOnly == it->artist && song->collateByTitleOnly == it->title) return it->id;
-	}
-	return -1;
+	return lookup(*song);
 }
 
-int SongItems::lookup(Song& song) const {
-	for (songs_t::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) {
-		if (song.collateByArtistOnly == it->artist && song.collateByTitleOnly == it->title) return it->id;
-	}
-	return -1;
+int SongItems::lookup(Song const& song) const {
+	index_t::const_iterator it = m_index.find(key(song.collateByArtistOnly, song.collateByTitleOnly));
+	return it == m_index.end() ? -1 : it->second;
 }
 
 std::string SongItems::lookup (int id) const {
@@ -8,6 +8,7 @@
 #include <stdexcept>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace xmlpp { class Node; class Element; typedef std::vector<Node*>NodeSet; }
 
@@ -35,7 +36,7 @@ struct SongItem
 	  E.g. the full artist information can be accessed using
 	  this pointer.
 	 */
-	boost::shared_ptr<Song> song;
+	mutable boost::shared_ptr<Song> song; ///< not part of the ordering, so it may be changed in the set
 
 	bool operator< (SongItem const& other) const
 	{
@@ -49,12 +50,9 @@ struct SongItem
   This class was introduced to hide the implementation
   detail which data structure is used for the list away.
 
-  Currently a std::set is used, which makes both addSongItem()
-  and addSong() slow. The only advantage is that the id is
-  unique and it is cheap to get a new unique id.
-
-  When one of the methods is to slow, it can be optimized
-  easily. */
+  The items are kept in a std::set ordered by id, which keeps the
+  id unique and makes it cheap to get a new unique id. A hash index
+  on the collated artist and title makes lookup() by song O(1). */
 struct SongItems
 {
 	void load(xmlpp::NodeSet const& n);
@@ -82,16 +80,26 @@ struct SongItems
 	/**Lookup a songid for a specific song.
 	  @return -1 if no song found.*/
 	int lookup(boost::shared_ptr<Song> song) const;
-	int lookup(Song& song) const;
+	int lookup(Song const& song) const;
 
 	/**Lookup the artist + title for a specific song.
 	  @return "Unknown Song" if nothing is found.
 	  */
 	std::string lookup (int id) const;
 
+	/// number of song items added (loaded or new), for journaling
+	std::size_t addedCount() const { return m_added.size(); }
+	/// song items in the order they were added
+	SongItem const& added(std::size_t pos) const { return *m_added[pos]; }
+
   private:
 	int assign_id_internal() const;
+	/// Key of the artist/title index (both in collated form)
+	static std::string key(std::string const& artist, std::string const& title) { return artist + '\0' + title; }
 
 	typedef std::set<SongItem> songs_t;
 	songs_t m_songs;
+	typedef boost::unordered_map<std::string, int> index_t;
+	index_t m_index; ///< Artist/title key to the lowest id with that artist and title
+	std::vector<songs_t::const_iterator> m_added; ///< All items in the order they were added
 };
@@ -0,0 +1,70 @@
+#include "songmeta.hh"
+
+#include "song.hh"
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <cstring>
+
+std::size_t StringPool::Hash::operator()(Id id) const {
+	char const* p = pool->data(id);
+	return boost::hash_range(p, p + pool->length(id));
+}
+
+std::size_t StringPool::Hash::operator()(std::string const& str) const {
+	return boost::hash_range(str.begin(), str.end());
+}
+
+bool StringPool::Equal::operator()(std::string const& str, Id id) const {
+	return str.size() == pool->length(id) && std::memcmp(str.data(), pool->data(id), str.size()) == 0;
+}
+
+StringPool::StringPool(): m_ids(16, Hash(this), Equal(this)) {
+	m_offsets.push_back(0);
+	intern("");  // Id 0 is the empty string
+}
+
+StringPool::Id StringPool::intern(std::string const& str) {
+	boost::unordered_set<Id, Hash, Equal>::const_iterator it = m_ids.find(str, Hash(this), Equal(this));
+	if (it != m_ids.end()) return *it;
+	Id id = m_offsets.size() - 1;
+	m_buffer.append(str.data(), str.size());
+	m_buffer += '\0';
+	m_offsets.push_back(m_buffer.size());
+	m_ids.insert(id);
+	return id;
+}
+
+bool StringPool::find(std::string const& str, Id& id) const {
+	boost::unordered_set<Id, Hash, Equal>::const_iterator it = m_ids.find(str, Hash(this), Equal(this));
+	if (it == m_ids.end()) return false;
+	id = *it;
+	return true;
+}
+
+bool StringPool::less(Id a, Id b) const {
+	if (a == b) return false;
+	std::size_t la = length(a), lb = length(b);
+	int cmp = std::memcmp(data(a), data(b), std::min(la, lb));
+	return cmp < 0 || (cmp == 0 && la < lb);
+}
+
+SongMeta::SongMeta(Song const& song, StringPool& strings):
+  path(strings.intern(song.path)),
+  filename(strings.intern(song.filename)),
+  title(strings.intern(song.title)),
+  artist(strings.intern(song.artist)),
+  edition(strings.intern(song.edition)),
+  genre(strings.intern(song.genre)),
+  language(strings.intern(song.language)),
+  cover(strings.intern(song.cover)),
+  collateByTitle(strings.intern(song.collateByTitle)),
+  collateByArtist(strings.intern(song.collateByArtist)),
+  randomIdx(song.randomIdx),
+  tracks()
+{
+	if (song.hasVocals()) tracks |= VOCALS;
+	if (song.hasGuitars()) tracks |= GUITARS;
+	if (song.hasDrums()) tracks |= DRUMS;
+	if (song.hasKeyboard()) tracks |= KEYBOARD;
+	if (song.hasDance()) tracks |= DANCE;
+}
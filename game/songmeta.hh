@@ -0,0 +1,68 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_set.hpp>
+#include <string>
+#include <vector>
+
+class Song;
+
+/**
+* @short Interned strings, stored back to back in one buffer.
+* Equal strings get the same id, so ids can be compared for equality directly.
+* Strings are never removed (a rescan of the same songs adds nothing).
+**/
+class StringPool: boost::noncopyable {
+  public:
+	typedef boost::uint32_t Id;
+	StringPool();
+	/// Get the id of a string, adding it if needed
+	Id intern(std::string const& str);
+	/// Look up an existing string without adding it
+	bool find(std::string const& str, Id& id) const;
+	/// Get a string by id
+	std::string str(Id id) const { return std::string(data(id), length(id)); }
+	/// Compare strings by id (same ordering as std::string)
+	bool less(Id a, Id b) const;
+  private:
+	char const* data(Id id) const { return m_buffer.data() + m_offsets[id]; }
+	std::size_t length(Id id) const { return m_offsets[id + 1] - m_offsets[id] - 1; }
+	struct Hash {
+		explicit Hash(StringPool const* p = NULL): pool(p) {}
+		StringPool const* pool;
+		std::size_t operator()(Id id) const;
+		std::size_t operator()(std::string const& str) const;
+	};
+	struct Equal {
+		explicit Equal(StringPool const* p = NULL): pool(p) {}
+		StringPool const* pool;
+		bool operator()(Id a, Id b) const { return a == b; }
+		bool operator()(std::string const& str, Id id) const;
+		bool operator()(Id id, std::string const& str) const { return operator()(str, id); }
+	};
+	std::string m_buffer; ///< All strings, each followed by a NUL
+	std::vector<boost::uint32_t> m_offsets; ///< Start of each string in m_buffer (plus end of the last one)
+	boost::unordered_set<Id, Hash, Equal> m_ids;
+};
+
+/**
+* @short Compact song information for browsing, searching and sorting.
+* The song library keeps these in one contiguous array; full Song objects are only loaded
+* for the songs that are actually shown or played.
+**/
+struct SongMeta {
+	/// Bits of tracks
+	enum Track { VOCALS = 1, GUITARS = 2, DRUMS = 4, KEYBOARD = 8, DANCE = 16 };
+	typedef StringPool::Id Str;
+	SongMeta(): path(), filename(), title(), artist(), edition(), genre(), language(), cover(), collateByTitle(), collateByArtist(), randomIdx(), tracks() {}
+	/// Extract the information of a song, interning its strings
+	SongMeta(Song const& song, StringPool& strings);
+	bool has(Track track) const { return tracks & track; }
+	Str path, filename;
+	Str title, artist, edition, genre, language;
+	Str cover;
+	Str collateByTitle, collateByArtist;
+	int randomIdx; ///< sorting index used for random order
+	unsigned tracks; ///< Track bits
+};
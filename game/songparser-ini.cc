@@ -2,7 +2,6 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/regex.hpp>
 #include <stdexcept>
 #include "midifile.hh"
 
@@ -12,30 +11,41 @@
 using namespace SongParserUtil;
 
 /// 'Magick' to check if this file looks like correct format
-bool SongParser::iniCheck(std::vector<char> const& data) const {
+bool SongParser::iniCheck(StringRef data) const {
 	static const std::string header = "[song]";
 	return std::equal(header.begin(), header.end(), data.begin());
 }
 
 namespace {
-	void testAndAdd(Song& s, std::string const& trackid, std::string const& filename) {
-		std::string f = s.path + filename;
-		if (boost::filesystem::exists(f)) s.music[trackid] = f;
+	enum Asset { MIDI, BACKGROUND, GUITAR, BASS, KEYBOARD, DRUMS, VOCALS };
+
+	SongDir::Rules makeAudioRules() {
+		SongDir::Rules rules;
+		rules.add(SongDir::Rules::SUFFIX, "mid", MIDI);
+		rules.add(SongDir::Rules::EXACT, "song.ogg", BACKGROUND);
+		rules.add(SongDir::Rules::EXACT, "guitar.ogg", GUITAR);
+		rules.add(SongDir::Rules::EXACT, "rhythm.ogg", BASS);
+		rules.add(SongDir::Rules::EXACT, "keyboard.ogg", KEYBOARD);
+		rules.add(SongDir::Rules::EXACT, "drums.ogg", DRUMS);
+		rules.add(SongDir::Rules::EXACT, "vocals.ogg", VOCALS);
+		return rules;
 	}
+
+	const SongDir::Rules audioRules = makeAudioRules();
 }
 
 /// Parse header data for Songs screen
 void SongParser::iniParseHeader() {
 	Song& s = m_song;
-	std::string line;
+	StringRef line;
 	while (getline(line)) {
 		if (line.empty()) continue;
 		if (line[0] == '[') continue; // Section header
-		std::istringstream iss(line);
-		std::string key, value;
-		if (!std::getline(iss, key, '=') || !std::getline(iss, value)) std::runtime_error("Invalid format, should be key=value");
-		boost::trim(key); boost::to_lower(key);
-		boost::trim(value);
+		std::size_t pos = line.find('=');
+		if (pos == line.size()) continue; // Not key=value, ignored
+		std::string key = line.substr(0, pos).trim().str();
+		boost::to_lower(key);
+		std::string value = line.substr(pos + 1).trim().str();
 		// Supported tags
 		if (key == "name") s.title = value;
 		else if (key == "artist") s.artist = value;
@@ -53,45 +63,16 @@ void SongParser::iniParseHeader() {
 
 	// Parse additional data from midi file - required to get tracks info
 	s.midifilename = "notes.mid";
-	// Compose regexps to find music files
-	boost::regex midifile("(.*\\.mid)$", boost::regex_constants::icase);
-	boost::regex audiofile_background("(song\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_guitar("(guitar\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_drums("(drums\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_bass("(rhythm\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_keyboard("(keyboard\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_vocals("(vocals\\.ogg)$", boost::regex_constants::icase);
-	boost::regex audiofile_other("(.*\\.ogg)$", boost::regex_constants::icase);
-	boost::cmatch match;
-
-	// Search the dir for the music files
-	for (boost::filesystem::directory_iterator dirIt(s.path), dirEnd; dirIt != dirEnd; ++dirIt) {
-		boost::filesystem::path p = dirIt->path();
-#if BOOST_FILESYSTEM_VERSION < 3
-		std::string name = p.leaf(); // File basename (notes.txt)
-#else
-		std::string name = p.filename().string(); // File basename (notes.txt)
-#endif
-		if (regex_match(name.c_str(), match, midifile)) {
-			 s.midifilename = name;
-		} else if (regex_match(name.c_str(), match, audiofile_background)) {
-			testAndAdd(s, "background", name);
-		} else if (regex_match(name.c_str(), match, audiofile_guitar)) {
-			testAndAdd(s, TrackName::GUITAR, name);
-		} else if (regex_match(name.c_str(), match, audiofile_bass)) {
-			testAndAdd(s, TrackName::BASS, name);
-		} else if (regex_match(name.c_str(), match, audiofile_keyboard)) {
-			testAndAdd(s, TrackName::KEYBOARD, name);
-		} else if (regex_match(name.c_str(), match, audiofile_drums)) {
-			testAndAdd(s, TrackName::DRUMS, name);
-		} else if (regex_match(name.c_str(), match, audiofile_vocals)) {
-			testAndAdd(s, "vocals", name);
-#if 0  // TODO: process preview.ogg properly? In any case, do not print debug to console...
-		} else if (regex_match(name.c_str(), match, audiofile_other)) {
-			std::cout << "Found unknown ogg file: " << name << std::endl;
-#endif
-		}
-	}
+	// Search the dir for the midi and music files
+	std::vector<std::string> found = songDir().find(audioRules);
+	if (!found[MIDI].empty()) s.midifilename = found[MIDI];
+	if (!found[BACKGROUND].empty()) s.music["background"] = s.path + found[BACKGROUND];
+	if (!found[GUITAR].empty()) s.music[TrackName::GUITAR] = s.path + found[GUITAR];
+	if (!found[BASS].empty()) s.music[TrackName::BASS] = s.path + found[BASS];
+	if (!found[KEYBOARD].empty()) s.music[TrackName::KEYBOARD] = s.path + found[KEYBOARD];
+	if (!found[DRUMS].empty()) s.music[TrackName::DRUMS] = s.path + found[DRUMS];
+	if (!found[VOCALS].empty()) s.music["vocals"] = s.path + found[VOCALS];
+	// TODO: process preview.ogg properly?
 	midParseHeader();
 }
 
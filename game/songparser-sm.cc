@@ -12,9 +12,9 @@
 using namespace SongParserUtil;
 
 /// 'Magick' to check if this file looks like correct format
-bool SongParser::smCheck(std::vector<char> const& data) const {
+bool SongParser::smCheck(StringRef data) const {
 	if (data[0] != '#' || data[1] < 'A' || data[1] > 'Z') return false;
-	for (std::vector<char>::const_iterator it = data.begin(); it != data.end(); ++it){
+	for (char const* it = data.begin(); it != data.end(); ++it){
 		if (*it == '\n') return false;
 		else if (*it == ';') return true;
 	}
@@ -40,9 +40,8 @@ void SongParser::smParseHeader() {
 	if (m_song.danceTracks.empty() ) throw std::runtime_error("No note data in the file");
 	if (s.title.empty() || s.artist.empty()) throw std::runtime_error("Required header fields missing");
 	std::string& music = s.music["background"];
-	std::string tmp = s.path + "music.ogg";
 	namespace fs = boost::filesystem;
-	if ((music.empty() || !fs::exists(music)) && fs::exists(tmp)) music = tmp;
+	if ((music.empty() || !fs::exists(music)) && songDir().exists("music.ogg")) music = s.path + "music.ogg";
 	// Convert stops to the format required in Song
 	s.stops.resize(m_stops.size());
 	for (std::size_t i = 0; i < m_stops.size(); ++i) s.stops[i] = stopConvert(m_stops[i]);
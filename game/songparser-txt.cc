@@ -12,17 +12,53 @@ using namespace SongParserUtil;
 
 namespace {
 	const std::string DUET_P2 = "Duet singer"; // FIXME
+
+	bool isBlank(char ch) { return ch == ' ' || ch == '\t'; }
+
+	/// Parse an integer at p (skipping leading blanks, like operator>>), advancing p past it
+	bool parseInt(char const*& p, char const* end, int& value) {
+		char const* it = p;
+		while (it != end && isBlank(*it)) ++it;
+		bool neg = false;
+		if (it != end && (*it == '-' || *it == '+')) neg = (*it++ == '-');
+		if (it == end || *it < '0' || *it > '9') return false;
+		long v = 0;
+		for (; it != end && *it >= '0' && *it <= '9'; ++it) {
+			v = v * 10 + (*it - '0');
+			if (v > 0x7FFFFFFF) return false;
+		}
+		value = (neg ? -v : v);
+		p = it;
+		return true;
+	}
+
+	bool parseUnsigned(char const*& p, char const* end, unsigned& value) {
+		int v;
+		if (!parseInt(p, end, v) || v < 0) return false;
+		value = v;
+		return true;
+	}
 }
 
 /// 'Magick' to check if this file looks like correct format
-bool SongParser::txtCheck(std::vector<char> const& data) const {
+bool SongParser::txtCheck(StringRef data) const {
 	return data[0] == '#' && data[1] >= 'A' && data[1] <= 'Z';
 }
 
+/// Find the end of the header (the first line that is not empty and not a #KEY:VALUE field)
+char const* SongParser::txtHeaderEnd(char const* begin, char const* end) {
+	char const* p = begin;
+	while (p != end && (*p == '#' || *p == '\n')) {
+		p = std::find(p, end, '\n');
+		if (p != end) ++p;
+	}
+	return p;
+}
+
 /// Parse header data for Songs screen
 void SongParser::txtParseHeader() {
 	Song& s = m_song;
-	std::string line;
+	StringRef line;
 	while (getline(line) && txtParseField(line)) {}
 	if (s.title.empty() || s.artist.empty()) throw std::runtime_error("Required header fields missing");
 	if (m_bpm != 0.0) addBPM(0, m_bpm);
@@ -31,7 +67,7 @@ void SongParser::txtParseHeader() {
 
 /// Parse notes
 void SongParser::txtParse() {
-	std::string line;
+	StringRef line;
 	m_curSinger = P1;
 	m_song.insertVocalTrack(TrackName::LEAD_VOCAL, VocalTrack(TrackName::LEAD_VOCAL));
 	m_song.insertVocalTrack(DUET_P2, VocalTrack(DUET_P2));
@@ -56,14 +92,15 @@ void SongParser::txtParse() {
 
 }
 
-bool SongParser::txtParseField(std::string const& line) {
+bool SongParser::txtParseField(StringRef line) {
 	if (line.empty()) return true;
 	if (line[0] != '#') return false;
-	std::string::size_type pos = line.find(':');
-	if (pos == std::string::npos) throw std::runtime_error("Invalid txt format, should be #key:value");
-	std::string key = boost::trim_copy(line.substr(1, pos - 1));
-	std::string value = boost::trim_copy(line.substr(pos + 1));
-	if (value.empty()) return true;
+	std::size_t pos = line.find(':');
+	if (pos == line.size()) throw std::runtime_error("Invalid txt format, should be #key:value");
+	StringRef key = line.substr(1, pos - 1).trim();
+	StringRef valueRef = line.substr(pos + 1).trim();
+	if (valueRef.empty()) return true;
+	std::string value = valueRef.str();
 	if (key == "TITLE") m_song.title = value.substr(value.find_first_not_of(" :"));
 	else if (key == "ARTIST") m_song.artist = value.substr(value.find_first_not_of(" "));
 	else if (key == "EDITION") m_song.edition = value.substr(value.find_first_not_of(" "));
@@ -84,13 +121,13 @@ bool SongParser::txtParseField(std::string const& line) {
 	return true;
 }
 
-bool SongParser::txtParseNote(std::string line) {
+bool SongParser::txtParseNote(StringRef line) {
 	if (line.empty() || line == "\r") return true;
 	if (line[0] == '#') throw std::runtime_error("Key found in the middle of notes");
-	if (line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+	if (line[line.size() - 1] == '\r') --line.e;
 	if (line[0] == 'E') return false;
-	std::istringstream iss(line);
 	if (line[0] == 'B') {
+		std::istringstream iss(line.str());
 		unsigned int ts;
 		double bpm;
 		iss.ignore();
@@ -110,7 +147,8 @@ bool SongParser::txtParseNote(std::string line) {
 		return true;
 	}
 	Note n;
-	n.type = Note::Type(iss.get());
+	n.type = Note::Type(line[0]);
+	char const* p = line.begin() + 1;
 	unsigned int ts = m_prevts;
 	switch (n.type) {
 	  case Note::NORMAL:
@@ -118,17 +156,17 @@ bool SongParser::txtParseNote(std::string line) {
 	  case Note::GOLDEN:
 		{
 			unsigned int length = 0;
-			if (!(iss >> ts >> length >> n.note)) throw std::runtime_error("Invalid note line format");
+			if (!parseUnsigned(p, line.end(), ts) || !parseUnsigned(p, line.end(), length) || !parseInt(p, line.end(), n.note)) throw std::runtime_error("Invalid note line format");
 			n.notePrev = n.note; // No slide notes in TXT yet.
 			if (m_relative) ts += m_relativeShift;
-			if (iss.get() == ' ') std::getline(iss, n.syllable);
+			if (p != line.end() && *p == ' ') n.syllable.assign(p + 1, line.end());
 			n.end = tsTime(ts + length);
 		}
 		break;
 	  case Note::SLEEP:
 		{
 			unsigned int end;
-			if (!(iss >> ts >> end)) end = ts;
+			if (!parseUnsigned(p, line.end(), ts) || !parseUnsigned(p, line.end(), end)) end = ts;
 			if (m_relative) {
 				ts += m_relativeShift;
 				end += m_relativeShift;
@@ -2,7 +2,6 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/regex.hpp>
 #include <stdexcept>
 
 /// @file
@@ -11,16 +10,24 @@
 using namespace SongParserUtil;
 
 /// 'Magick' to check if this file looks like correct format
-bool SongParser::xmlCheck(std::vector<char> const& data) const {
+bool SongParser::xmlCheck(StringRef data) const {
 	static const std::string header = "<?";
 	return std::equal(header.begin(), header.end(), data.begin());
 }
 
 namespace {
-	void testAndAdd(Song& s, std::string const& trackid, std::string const& filename) {
-		std::string f = s.path + filename;
-		if (boost::filesystem::exists(f)) s.music[trackid] = f;
+	enum Asset { COVER, VIDEO, MUSIC, VOCALS };
+
+	SongDir::Rules makeAssetRules() {
+		SongDir::Rules rules;
+		rules.add(SongDir::Rules::PREFIX, "cover", COVER);
+		rules.add(SongDir::Rules::PREFIX, "video", VIDEO);
+		rules.add(SongDir::Rules::PREFIX, "music", MUSIC);
+		rules.add(SongDir::Rules::PREFIX, "vocals", VOCALS);
+		return rules;
 	}
+
+	const SongDir::Rules assetRules = makeAssetRules();
 }
 
 #include <libxml++/libxml++.h>
@@ -35,8 +42,8 @@ void disableXMLLogger() { xmlSetGenericErrorFunc(NULL, xmlLogger); }
 
 struct SSDom: public xmlpp::DomParser {
 	xmlpp::Node::PrefixNsMap nsmap;
-	SSDom(std::stringstream const& _ss) {
-		load(_ss.str());
+	SSDom(char const* begin, char const* end) {
+		load(std::string(begin, end));
 	}
 	void load(std::string const& buf) {
 		set_substitute_entities();
@@ -74,29 +81,11 @@ struct SSDom: public xmlpp::DomParser {
 void SongParser::xmlParseHeader() {
 	Song& s = m_song;
 
-	boost::cmatch match;
-	boost::regex coverfile("(cover\\..*)$", boost::regex_constants::icase);
-	boost::regex videofile("(video\\..*)$", boost::regex_constants::icase);
-	boost::regex musicfile("(music\\..*)$", boost::regex_constants::icase);
-	boost::regex vocalsfile("(vocals\\..*)$", boost::regex_constants::icase);
-
-	for (boost::filesystem::directory_iterator dirIt(s.path), dirEnd; dirIt != dirEnd; ++dirIt) {
-		boost::filesystem::path p = dirIt->path();
-#if BOOST_FILESYSTEM_VERSION < 3
-		std::string name = p.leaf(); // File basename (notes.xml)
-#else
-		std::string name = p.filename().string(); // File basename (notes.xml)
-#endif
-		if (regex_match(name.c_str(), match, coverfile)) {
-			s.cover = name;
-		} else if (regex_match(name.c_str(), match, videofile)) {
-			s.video = name;
-		} else if (regex_match(name.c_str(), match, musicfile)) {
-			testAndAdd(s, "background", name);
-		} else if (regex_match(name.c_str(), match, vocalsfile)) {
-			testAndAdd(s, "vocals", name);
-		}
-	}
+	std::vector<std::string> found = songDir().find(assetRules);
+	if (!found[COVER].empty()) s.cover = found[COVER];
+	if (!found[VIDEO].empty()) s.video = found[VIDEO];
+	if (!found[MUSIC].empty()) s.music["background"] = s.path + found[MUSIC];
+	if (!found[VOCALS].empty()) s.music["vocals"] = s.path + found[VOCALS];
 
 	xmlParse();
 	if (s.title.empty() || s.artist.empty()) throw std::runtime_error("Required header fields missing");
@@ -132,7 +121,7 @@ void addNoteToTracks(std::string sentenceSinger, Song& song, const Note& note) {
 /// Parse notes
 void SongParser::xmlParse() {
 	// parse content
-	SSDom dom(m_ss);
+	SSDom dom(m_begin, m_end);
 	Song& s = m_song;
 	// Extract artist and title from XML comments
 	{
@@ -1,9 +1,8 @@
 #include "songparser.hh"
 
-#include <fstream>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/regex.hpp>
+#include <cctype>
 
 
 namespace SongParserUtil {
@@ -30,12 +29,44 @@ namespace SongParserUtil {
 	void eraseLast(std::string& s, char ch) {
 		if (!s.empty() && *s.rbegin() == ch) s.erase(s.size() - 1);
 	}
+	StringRef StringRef::trim() const {
+		char const* begin = b;
+		char const* end = e;
+		while (begin != end && std::isspace(static_cast<unsigned char>(*begin))) ++begin;
+		while (begin != end && std::isspace(static_cast<unsigned char>(end[-1]))) --end;
+		return StringRef(begin, end);
+	}
 }
 
 
+namespace {
+	enum Asset { COVER, BACKGROUND, VIDEO };
+
+	SongDir::Rules makeAssetRules() {
+		SongDir::Rules rules;
+		char const* images[] = { "png", "jpeg", "jpg", "svg" };
+		char const* covers[] = { "cover", "album", "label", "[co]" };
+		char const* backgrounds[] = { "background", "bg", "", "[bg]" };
+		char const* videos[] = { "avi", "mpg", "mpeg", "flv", "mov", "mp4" };
+		for (unsigned i = 0; i < 4; ++i) {
+			for (unsigned j = 0; j < 4; ++j) {
+				rules.add(SongDir::Rules::EXACT, std::string(covers[i]) + "." + images[j], COVER);
+				rules.add(SongDir::Rules::EXACT, std::string(backgrounds[i]) + "." + images[j], BACKGROUND);
+			}
+		}
+		for (unsigned i = 0; i < 6; ++i) rules.add(SongDir::Rules::SUFFIX, videos[i], VIDEO);
+		return rules;
+	}
+
+	const SongDir::Rules assetRules = makeAssetRules();
+}
+
 /// constructor
 SongParser::SongParser(Song& s):
   m_song(s),
+  m_begin(),
+  m_pos(),
+  m_end(),
   m_linenum(),
   m_relative(),
   m_gap(),
@@ -47,24 +78,40 @@ SongParser::SongParser(Song& s):
   m_tsEnd()
 {
 	enum { NONE, TXT, XML, INI, SM } type = NONE;
-	// Read the file, determine the type and do some initial validation checks
+	// Map the file, determine the type and do some initial validation checks
+	std::string filename = s.path + s.filename;
+	try {
+		m_file.open(filename);
+	} catch (std::exception&) {
+		throw SongParserException("Could not open song file", 0);
+	}
+	if (m_file.size() < 10 || m_file.size() > 100000) throw SongParserException("Does not look like a song file (wrong size)", 1, true);
 	{
-		std::ifstream f((s.path + s.filename).c_str(), std::ios::binary);
-		if (!f.is_open()) throw SongParserException("Could not open song file", 0);
-		f.seekg(0, std::ios::end);
-		size_t size = f.tellg();
-		if (size < 10 || size > 100000) throw SongParserException("Does not look like a song file (wrong size)", 1, true);
-		f.seekg(0);
-		std::vector<char> data(size);
-		if (!f.read(&data[0], size)) throw SongParserException("Unexpected I/O error", 0);
+		SongParserUtil::StringRef data(m_file.begin(), m_file.end());
 		if (smCheck(data)) type = SM;
 		else if (txtCheck(data)) type = TXT;
 		else if (iniCheck(data)) type = INI;
 		else if (xmlCheck(data)) type = XML;
 		else throw SongParserException("Does not look like a song file (wrong header)", 1, true);
-		m_ss.write(&data[0], size);
 	}
-	convertToUTF8(m_ss, s.path + s.filename);
+	// TXT header ends at the first note line, there is no need to look any further
+	m_begin = m_file.begin();
+	m_end = (type == TXT && s.loadStatus != Song::HEADER ? txtHeaderEnd(m_file.begin(), m_file.end()) : m_file.end());
+	// Use the data in place if it is valid UTF-8, otherwise convert it
+	if (isUTF8(m_begin, m_end)) {
+		if (m_end - m_begin >= 3 && std::equal(m_begin, m_begin + 3, "\xEF\xBB\xBF")) {
+			std::clog << "unicode/warning: " << filename << " UTF-8 BOM ignored. Please avoid editors that use BOMs (e.g. Notepad)." << std::endl;
+			m_begin += 3;
+		}
+	} else {
+		std::stringstream ss;
+		ss.write(m_begin, m_end - m_begin);
+		convertToUTF8(ss, filename);
+		m_converted = ss.str();
+		m_begin = m_converted.data();
+		m_end = m_begin + m_converted.size();
+	}
+	m_pos = m_begin;
 	// Header already parsed?
 	if (s.loadStatus == Song::HEADER) {
 		try {
@@ -92,32 +139,17 @@ SongParser::SongParser(Song& s):
 	}
 
 	// Remove bogus entries
-	if (!boost::filesystem::exists(m_song.path + m_song.cover)) m_song.cover = "";
-	if (!boost::filesystem::exists(m_song.path + m_song.background)) m_song.background = "";
-	if (!boost::filesystem::exists(m_song.path + m_song.video)) m_song.video = "";
+	SongDir const& dir = songDir();
+	if (!dir.exists(m_song.cover)) m_song.cover = "";
+	if (!dir.exists(m_song.background)) m_song.background = "";
+	if (!dir.exists(m_song.video)) m_song.video = "";
 
 	// In case no images/videos were specified, try to guess them
 	if (m_song.cover.empty() || m_song.background.empty() || m_song.video.empty()) {
-		boost::regex coverfile("((cover|album|label|\\[co\\])\\.(png|jpeg|jpg|svg))$", boost::regex_constants::icase);
-		boost::regex backgroundfile("((background|bg||\\[bg\\])\\.(png|jpeg|jpg|svg))$", boost::regex_constants::icase);
-		boost::regex videofile("(.*\\.(avi|mpg|mpeg|flv|mov|mp4))$", boost::regex_constants::icase);
-		boost::cmatch match;
-
-		for (boost::filesystem::directory_iterator dirIt(s.path), dirEnd; dirIt != dirEnd; ++dirIt) {
-			boost::filesystem::path p = dirIt->path();
-#if BOOST_FILESYSTEM_VERSION < 3
-			std::string name = p.leaf(); // File basename
-#else
-			std::string name = p.filename().string(); // File basename
-#endif
-			if (m_song.cover.empty() && regex_match(name.c_str(), match, coverfile)) {
-				m_song.cover = name;
-			} else if (m_song.background.empty() && regex_match(name.c_str(), match, backgroundfile)) {
-				m_song.background = name;
-			} else if (m_song.video.empty() && regex_match(name.c_str(), match, videofile)) {
-				m_song.video = name;
-			}
-		}
+		std::vector<std::string> found = dir.find(assetRules);
+		if (m_song.cover.empty()) m_song.cover = found[COVER];
+		if (m_song.background.empty()) m_song.background = found[BACKGROUND];
+		if (m_song.video.empty()) m_song.video = found[VIDEO];
 	}
 	s.loadStatus = Song::HEADER;
 }
@@ -160,6 +192,7 @@ void SongParser::finalize() {
 				it->notePrev += shift;
 			}
 		}
+		vocal.timeline.assign(vocal.notes);
 		// Set begin/end times
 		if (!vocal.notes.empty()) vocal.beginTime = vocal.notes.front().begin, vocal.endTime = vocal.notes.back().end;
 		// Compute maximum score
@@ -1,11 +1,34 @@
 #pragma once
 
+#include "mappedfile.hh"
 #include "song.hh"
+#include "songdir.hh"
 #include "unicode.hh"
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <boost/filesystem.hpp>
 
 namespace SongParserUtil {
+	/// A piece of the song file (does not own the data)
+	struct StringRef {
+		StringRef(): b(), e() {}
+		StringRef(char const* begin, char const* end): b(begin), e(end) {}
+		char const* begin() const { return b; }
+		char const* end() const { return e; }
+		std::size_t size() const { return e - b; }
+		bool empty() const { return b == e; }
+		char operator[](std::size_t i) const { return b[i]; }
+		std::string str() const { return std::string(b, e); }
+		bool operator==(char const* s) const { return size() == std::strlen(s) && std::equal(b, e, s); }
+		/// Position of the first occurrence of ch (or size() if not found)
+		std::size_t find(char ch) const { return std::find(b, e, ch) - b; }
+		StringRef substr(std::size_t pos, std::size_t len = std::size_t(-1)) const { return StringRef(b + pos, b + pos + std::min(len, size() - pos)); }
+		/// Strip whitespace from both ends
+		StringRef trim() const;
+		char const* b;
+		char const* e;
+	};
 	/// Parse an int from string and assign it to a variable
 	void assign(int& var, std::string const& str);
 	/// Parse a double from string and assign it to a variable
@@ -27,29 +50,50 @@ class SongParser {
 	void finalize();
 
 	Song& m_song;
-	std::stringstream m_ss;
+	boost::shared_ptr<SongDir const> m_dir; ///< Listing of the song folder (loaded when first needed)
+	SongDir const& songDir() { if (!m_dir) m_dir = SongDir::get(m_song.path); return *m_dir; }
+	MappedFile m_file;
+	std::string m_converted; ///< File contents converted to UTF-8 (only if the file was not UTF-8)
+	char const* m_begin; ///< Start of the UTF-8 contents
+	char const* m_pos; ///< Current reading position
+	char const* m_end; ///< End of the contents (or of the header when only that is parsed)
 	unsigned int m_linenum;
-	bool getline(std::string& line) { ++m_linenum; return std::getline(m_ss, line);}
+	/// Read the next line (without the newline, but with a possible CR), the line points into the file contents
+	bool getline(SongParserUtil::StringRef& line) {
+		++m_linenum;
+		if (m_pos == m_end) return false;
+		char const* nl = std::find(m_pos, m_end, '\n');
+		line = SongParserUtil::StringRef(m_pos, nl);
+		m_pos = (nl == m_end ? nl : nl + 1);
+		return true;
+	}
+	bool getline(std::string& line) {
+		SongParserUtil::StringRef ref;
+		if (!getline(ref)) return false;
+		line.assign(ref.begin(), ref.end());
+		return true;
+	}
 	bool m_relative;
 	double m_gap;
 	double m_bpm;
 
-	bool txtCheck(std::vector<char> const& data) const;
+	bool txtCheck(SongParserUtil::StringRef data) const;
+	static char const* txtHeaderEnd(char const* begin, char const* end);
 	void txtParseHeader();
 	void txtParse();
-	bool txtParseField(std::string const& line);
-	bool txtParseNote(std::string line);
-	bool iniCheck(std::vector<char> const& data) const;
+	bool txtParseField(SongParserUtil::StringRef line);
+	bool txtParseNote(SongParserUtil::StringRef line);
+	bool iniCheck(SongParserUtil::StringRef data) const;
 	void iniParseHeader();
 	void iniParse();
-	bool midCheck(std::vector<char> const& data) const;
+	bool midCheck(SongParserUtil::StringRef data) const;
 	void midParseHeader();
 	void midParse();
-	bool xmlCheck(std::vector<char> const& data) const;
+	bool xmlCheck(SongParserUtil::StringRef data) const;
 	void xmlParseHeader();
 	void xmlParse();
 	Note xmlParseNote(xmlpp::Element const& noteNode, unsigned& ts);
-	bool smCheck(std::vector<char> const& data) const;
+	bool smCheck(SongParserUtil::StringRef data) const;
 	void smParseHeader();
 	void smParse();
 	bool smParseField(std::string line);
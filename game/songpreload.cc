@@ -0,0 +1,111 @@
+#include "songpreload.hh"
+
+#include "song.hh"
+#include "songparser.hh"
+#include "songtimelines.hh"
+#include <boost/bind.hpp>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	const std::size_t READAHEAD_SIZE = 4 << 20;  ///< Bytes read from the beginning of each media file
+	const std::size_t READAHEAD_CHUNK = 256 << 10;  ///< Cancellation is checked between chunks
+}
+
+SongPreload::SongPreload(): m_serial(), m_pending(), m_quit() {
+	m_thread.reset(new boost::thread(boost::bind(&SongPreload::run, this)));
+}
+
+SongPreload::~SongPreload() {
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		m_quit = true;
+		++m_serial;
+	}
+	m_cond.notify_all();
+	m_thread->join();
+}
+
+void SongPreload::request(Song const& song) {
+	Job job;
+	job.path = song.path;
+	job.filename = song.filename;
+	for (Song::Music::const_iterator it = song.music.begin(); it != song.music.end(); ++it) {
+		if (!it->second.empty()) job.files.push_back(it->second);
+	}
+	if (!song.video.empty()) job.files.push_back(song.path + song.video);
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		if (m_job.path == job.path && m_job.filename == job.filename) return;  // Already requested
+		m_job = job;
+		++m_serial;
+		m_pending = true;
+		m_ready.reset();
+	}
+	m_cond.notify_all();
+}
+
+void SongPreload::cancel() {
+	boost::mutex::scoped_lock l(m_mutex);
+	m_job = Job();
+	++m_serial;
+	m_pending = false;
+	m_ready.reset();
+}
+
+boost::shared_ptr<Song> SongPreload::take(Song const& song) {
+	boost::shared_ptr<Song> ret;
+	boost::mutex::scoped_lock l(m_mutex);
+	if (!m_ready || m_ready->path != song.path || m_ready->filename != song.filename) return ret;
+	ret.swap(m_ready);
+	m_job = Job();
+	return ret;
+}
+
+bool SongPreload::current(unsigned serial) {
+	boost::mutex::scoped_lock l(m_mutex);
+	return serial == m_serial;
+}
+
+void SongPreload::run() {
+	while (true) {
+		Job job;
+		unsigned serial;
+		{
+			boost::mutex::scoped_lock l(m_mutex);
+			while (!m_pending && !m_quit) m_cond.wait(l);
+			if (m_quit) return;
+			job = m_job;
+			serial = m_serial;
+			m_pending = false;
+		}
+		boost::shared_ptr<Song> song;
+		try {
+			song.reset(new Song(job.path, job.filename));  // Header
+			if (!current(serial)) continue;
+			SongParser sp(*song);  // Notes
+			if (!current(serial)) continue;
+			// The initial chords and dance notes of the graphs
+			boost::shared_ptr<SongTimelines> timelines(new SongTimelines());
+			GuitarGraph::prepare(*song, *timelines);
+			DanceGraph::prepare(*song, *timelines);
+			song->timelines = timelines;
+		} catch (std::exception& e) {
+			// ScreenSing will try again and report the error
+			std::clog << "songs/warning: Preloading " << job.path << job.filename << " failed: " << e.what() << std::endl;
+			continue;
+		}
+		for (std::size_t i = 0; i < job.files.size() && current(serial); ++i) readAhead(job.files[i], serial);
+		boost::mutex::scoped_lock l(m_mutex);
+		if (serial == m_serial) m_ready = song;
+	}
+}
+
+void SongPreload::readAhead(std::string const& file, unsigned serial) {
+	std::ifstream f(file.c_str(), std::ios::binary);
+	std::vector<char> buf(READAHEAD_CHUNK);
+	for (std::size_t total = 0; f && total < READAHEAD_SIZE && current(serial); total += buf.size()) {
+		f.read(&buf[0], buf.size());
+	}
+}
+
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+
+class Song;
+
+/**
+* @short Prepares the selected song for performing, in the background.
+* Parses the complete song (all notes) into a separate Song object, builds the note timelines
+* that the instrument and dance graphs start with (Song::timelines) and reads the beginning of
+* its audio and video files so that they are in the disk cache once decoding starts.
+* Video itself is opened by ScreenSing because its texture needs the OpenGL context.
+* Only the most recent request is worked on; a new request or cancel() abandons the previous
+* one at the next checkpoint.
+**/
+class SongPreload: boost::noncopyable {
+  public:
+	SongPreload();
+	~SongPreload();
+	/// Start preparing a song (header loaded), replacing any previous request
+	void request(Song const& song);
+	/// Abandon the current request
+	void cancel();
+	/// Get the prepared copy of a song, or an empty pointer if it is not ready (yet)
+	boost::shared_ptr<Song> take(Song const& song);
+
+  private:
+	struct Job {
+		std::string path, filename;
+		std::vector<std::string> files; ///< Media files to read ahead
+	};
+	void run();
+	bool current(unsigned serial);
+	void readAhead(std::string const& file, unsigned serial);
+	boost::mutex m_mutex;
+	boost::condition m_cond;
+	Job m_job; ///< The most recent request
+	unsigned m_serial; ///< Incremented by each request and cancel
+	bool m_pending; ///< m_job has not been picked up by the worker yet
+	bool m_quit;
+	boost::shared_ptr<Song> m_ready; ///< Result of the most recent request, once done
+	boost::scoped_ptr<boost::thread> m_thread;
+};
+
@@ -3,9 +3,14 @@
 #include "configuration.hh"
 #include "fs.hh"
 #include "song.hh"
+#include "songdir.hh"
+#include "songindex.hh"
+#include "songscanner.hh"
 #include "database.hh"
 #include "i18n.hh"
 #include "profiler.hh"
+#include "unicode.hh"
+#include "xtime.hh"
 
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
@@ -17,7 +22,23 @@
 #include <stdexcept>
 #include <cstdlib>
 
-Songs::Songs(Database & database, std::string const& songlist): m_songlist(songlist), math_cover(), m_typeFilter(), m_database(database), m_order(), m_dirty(false), m_loading(false) {
+namespace {
+	const std::size_t LOADED_MAX = 64;  ///< Loaded songs kept in memory for browsing
+
+	/// Names of song files of all supported formats
+	SongDir::Rules makeSongFileRules() {
+		SongDir::Rules rules;
+		rules.add(SongDir::Rules::SUFFIX, "txt", 0);
+		rules.add(SongDir::Rules::EXACT, "song.ini", 0);
+		rules.add(SongDir::Rules::EXACT, "notes.xml", 0);
+		rules.add(SongDir::Rules::SUFFIX, "sm", 0);
+		return rules;
+	}
+
+	const SongDir::Rules songFileRules = makeSongFileRules();
+}
+
+Songs::Songs(Database & database, std::string const& songlist): m_songlist(songlist), m_merged(), m_rebuild(true), math_cover(), m_typeFilter(), m_database(database), m_order(), m_dirty(false), m_loading(false), m_generation(), m_filteredGeneration(), m_used() {
 	m_updateTimer.setTarget(getInf()); // Using this as a simple timer counting seconds
 	reload();
 }
@@ -35,93 +56,300 @@ void Songs::reload() {
 }
 
 void Songs::reload_internal() {
+	m_watcher.reset();  // Everything gets rescanned anyway
 	{
 		boost::mutex::scoped_lock l(m_mutex);
 		m_songs.clear();
+		m_scanned.clear();
+		m_search.clear();
+		m_ranks.clear();
+		m_index.reset();
+		++m_generation;
+		m_rebuild = true;
 		m_dirty = true;
 	}
 	Profiler prof("songloader");
+	SongDir::Scan dirScan;  // Folder listings are shared by the song files in them
+	SongIndex index(getCacheDir() / "songindex.dat");
+	prof("index");
+	SongScanner scanner(index, boost::bind(&Songs::addSongs_internal, this, _1, _2), m_loading);
+	boost::xtime start = now();
 	Paths paths = getPathsConfig("paths/songs");
 	for (Paths::iterator it = paths.begin(); m_loading && it != paths.end(); ++it) {
+		// The scanner threads add songs and log concurrently, so the messages of the walk are collected
+		// locally and m_songs is only accessed with m_mutex locked
+		std::ostringstream log;
 		try {
-			if (!fs::is_directory(*it)) { m_debug << "Songs/info: >>> Not scanning: " << *it << " (no such directory)" << std::endl; continue; }
-			m_debug << "songs/info: >>> Scanning " << *it << std::endl;
-			size_t count = m_songs.size();
-			reload_internal(*it);
-			size_t diff = m_songs.size() - count;
-			if (diff > 0 && m_loading) m_debug << diff << " songs loaded" << std::endl;
+			if (!fs::is_directory(*it)) { log << "Songs/info: >>> Not scanning: " << *it << " (no such directory)" << std::endl; log_internal(log.str()); continue; }
+			log << "songs/info: >>> Scanning " << *it << std::endl;
+			size_t count = songCount_internal();
+			reload_internal(*it, scanner, log);
+			scanner.finish();
+			size_t diff = songCount_internal() - count;
+			if (diff > 0 && m_loading) log << diff << " songs loaded" << std::endl;
 		} catch (std::exception& e) {
-			m_debug << "songs/error: >>> Error scanning " << *it << ": " << e.what() << std::endl;
+			scanner.finish();
+			log << "songs/error: >>> Error scanning " << *it << ": " << e.what() << std::endl;
 		}
+		log_internal(log.str());
+	}
+	prof("scan");
+	if (m_loading) {
+		double t = now() - start;
+		boost::mutex::scoped_lock l(m_mutex);
+		m_debug << boost::format("songs/info: Scanned %u files in %.2f s (%.0f files/s) using %u threads, %u restored from the song index")
+		  % scanner.files() % t % (scanner.files() / std::max(t, 1e-3)) % scanner.threads() % index.hits() << std::endl;
+	}
+	if (m_loading) {
+		index.save();  // Only save complete scans, so that songs are not dropped from the index
+		// Reopen it for loading the full songs when browsing
+		boost::scoped_ptr<SongIndex> saved(new SongIndex(getCacheDir() / "songindex.dat"));
+		boost::mutex::scoped_lock l(m_mutex);
+		m_index.swap(saved);
+		SongVector().swap(m_scanned);  // Browsing uses the index from now on
+		prof("save");
+	}
+	if (m_loading) {
+		ranks_internal();
+		prof("sort");
 	}
-	prof("total");
 	if (m_loading) dumpSongs_internal(); // Dump the songlist to file (if requested)
+	if (m_loading && config["paths/songs_watch"].b()) {
+		// Watch for changes so that songs can be updated without a full rescan
+		std::vector<std::string> files;
+		for (Metas::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) files.push_back(m_strings.str(it->path) + m_strings.str(it->filename));
+		m_watcher.reset(new SongWatcher(paths, files));
+	}
 	m_loading = false;
 }
 
-void Songs::reload_internal(fs::path const& parent) {
+void Songs::reload_internal(fs::path const& parent, SongScanner& scanner, std::ostream& log) {
 	namespace fs = fs;
-	if (std::distance(parent.begin(), parent.end()) > 20) { m_debug << "songs/info: >>> Not scanning: " << parent.string() << " (maximum depth reached, possibly due to cyclic symlinks)" << std::endl; return; }
+	if (std::distance(parent.begin(), parent.end()) > 20) { log << "songs/info: >>> Not scanning: " << parent.string() << " (maximum depth reached, possibly due to cyclic symlinks)" << std::endl; return; }
 	try {
-		boost::regex expression("(.*\\.txt|^song\\.ini|notes\\.xml|.*\\.sm)$", boost::regex_constants::icase);
-		boost::cmatch match;
+		// List the folder first so that the listing can be shared with the song parsers
+		std::vector<fs::path> entries;
+		std::vector<std::string> names;
 		for (fs::directory_iterator dirIt(parent), dirEnd; m_loading && dirIt != dirEnd; ++dirIt) {
-			fs::path p = dirIt->path();
-			if (fs::is_directory(p)) { reload_internal(p); continue; }
+			entries.push_back(dirIt->path());
 #if BOOST_FILESYSTEM_VERSION < 3
-			std::string name = p.leaf(); // File basename (notes.txt)
-			std::string path = p.directory_string(); // Path without filename
+			names.push_back(entries.back().leaf()); // File basename (notes.txt)
 #else
-			std::string name = p.filename().string(); // File basename (notes.txt)
-			std::string path = p.string(); // Path without filename
+			names.push_back(entries.back().filename().string()); // File basename (notes.txt)
 #endif
-			path.erase(path.size() - name.size());
-			if (!regex_match(name.c_str(), match, expression)) continue;
+		}
+		std::string path = SongWatcher::dirKey(parent); // Path without filename
+		SongDir::put(path, names);
+		for (std::size_t i = 0; m_loading && i < entries.size(); ++i) {
+			if (fs::is_directory(entries[i])) { reload_internal(entries[i], scanner, log); continue; }
+			if (songFileRules.classify(names[i]) >= 0) scanner.add(path, names[i]);  // Parsed by the worker threads
+		}
+	} catch (std::exception const& e) {
+		log << "songs/error: Error accessing " << parent << e.what() << std::endl;
+	}
+}
+
+void Songs::addSongs_internal(SongVector& songs, std::string const& log) {
+	std::vector<std::string> keys;
+	for (SongVector::const_iterator it = songs.begin(); it != songs.end(); ++it) keys.push_back(unicodeSearchKey((*it)->strFull()));
+	boost::mutex::scoped_lock l(m_mutex);
+	for (size_t i = 0; i < songs.size(); ++i) {
+		// Only the compact information is kept, the full song is loaded again when needed
+		m_songs.push_back(SongMeta(*songs[i], m_strings));
+		m_songs.back().randomIdx = rand();
+		m_scanned.push_back(songs[i]);
+		m_search.add(keys[i]);
+	}
+	m_debug << log;
+	if (!songs.empty()) m_dirty = true;
+}
+
+void Songs::log_internal(std::string const& log) {
+	boost::mutex::scoped_lock l(m_mutex);
+	m_debug << log;
+}
+
+std::size_t Songs::songCount_internal() const {
+	boost::mutex::scoped_lock l(m_mutex);
+	return m_songs.size();
+}
+
+namespace {
+	/// Collects the results of a SongScanner
+	struct Collect {
+		SongScanner::Batch& songs;
+		std::string& log;
+		Collect(SongScanner::Batch& s, std::string& l): songs(s), log(l) {}
+		void operator()(SongScanner::Batch& batch, std::string const& msg) {
+			songs.insert(songs.end(), batch.begin(), batch.end());
+			log += msg;
+		}
+	};
+	/// Is there any entry in the sorted set that begins with prefix
+	bool hasPrefix(std::set<std::string> const& s, std::string const& prefix) {
+		std::set<std::string>::const_iterator it = s.lower_bound(prefix);
+		return it != s.end() && it->compare(0, prefix.size(), prefix) == 0;
+	}
+}
+
+void Songs::refresh_internal(SongWatcher::Dirs const& dirs) {
+	Profiler prof("songrefresh");
+	// Only this thread modifies m_songs and m_strings while loading, so they can be read without locking
+	std::set<std::string> known;  // Folders that contain songs
+	for (Metas::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) known.insert(m_strings.str(it->path));
+	// Parse the song files of the changed folders (unchanged files are restored from the song index)
+	SongScanner::Batch found;
+	std::string log;
+	{
+		SongDir::Scan dirScan;
+		SongIndex index(getCacheDir() / "songindex.dat");
+		SongScanner scanner(index, Collect(found, log), m_loading, 1);
+		std::set<std::string> scanned;  // Folders scanned recursively
+		std::ostringstream walk;  // Messages of this thread (log is written by the scanner thread)
+		for (SongWatcher::Dirs::const_iterator dir = dirs.begin(); m_loading && dir != dirs.end(); ++dir) {
 			try {
-				boost::shared_ptr<Song>s(new Song(path, name));
-				s->randomIdx = rand();
+				if (!fs::is_directory(*dir) || scanned.find(*dir) != scanned.end()) continue;
+				for (fs::directory_iterator dirIt(*dir), dirEnd; m_loading && dirIt != dirEnd; ++dirIt) {
+					fs::path p = dirIt->path();
+					if (fs::is_directory(p)) {
+						// New folders (or ones moved in with their contents) produce no events of their own
+						std::string sub = SongWatcher::dirKey(p);
+						if (hasPrefix(known, sub) || scanned.find(sub) != scanned.end()) continue;
+						scanned.insert(sub);
+						reload_internal(p, scanner, walk);
+						continue;
+					}
+#if BOOST_FILESYSTEM_VERSION < 3
+					std::string name = p.leaf();
+#else
+					std::string name = p.filename().string();
+#endif
+					if (songFileRules.classify(name) >= 0) scanner.add(*dir, name);
+				}
+			} catch (std::exception& e) {
+				walk << "songs/error: Error accessing " << *dir << ": " << e.what() << std::endl;
+			}
+		}
+		scanner.finish();
+		log += walk.str();
+		if (m_loading) {
+			// Store the refreshed songs so that they are not parsed again on the next start
+			// (m_index maps the same file, so it is closed while the file is replaced)
+			{
 				boost::mutex::scoped_lock l(m_mutex);
-				m_songs.push_back(s);
-				m_dirty = true;
-			} catch (SongParserException& e) {
-				if (e.silent()) continue;
-				// Construct error message
-				m_debug << "songs/error: -!- Error in " << path << "\n    " << name;
-				if (e.line()) m_debug << " line " << e.line();
-				m_debug << ": " << e.what() << std::endl;
+				m_index.reset();
 			}
+			index.save(false);
+			boost::scoped_ptr<SongIndex> saved(new SongIndex(getCacheDir() / "songindex.dat"));
+			boost::mutex::scoped_lock l(m_mutex);
+			m_index.swap(saved);
 		}
-	} catch (std::exception const& e) {
-		m_debug << "songs/error: Error accessing " << parent << e.what() << std::endl;
 	}
+	prof("parse");
+	// Merge into the song list, keeping the position and the random index of updated songs
+	typedef std::map<std::string, boost::shared_ptr<Song> > ByFile;
+	ByFile fresh;
+	for (SongScanner::Batch::const_iterator it = found.begin(); it != found.end(); ++it) fresh[(*it)->path + (*it)->filename] = *it;
+	unsigned updated = 0, removed = 0;
+	Metas songs;
+	songs.reserve(m_songs.size() + fresh.size());
+	std::vector<std::pair<std::size_t, boost::shared_ptr<Song> > > parsed;  // Position in songs, parsed song
+	for (Metas::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) {
+		std::string path = m_strings.str(it->path);
+		bool affected = dirs.find(path) != dirs.end();
+		// Songs in removed subfolders of a changed folder
+		for (SongWatcher::Dirs::const_iterator dir = dirs.begin(); !affected && dir != dirs.end(); ++dir) {
+			affected = path.compare(0, dir->size(), *dir) == 0 && !fs::is_directory(path);
+		}
+		if (!affected) { songs.push_back(*it); continue; }
+		ByFile::iterator f = fresh.find(path + m_strings.str(it->filename));
+		if (f == fresh.end()) { ++removed; continue; }
+		f->second->randomIdx = it->randomIdx;
+		parsed.push_back(std::make_pair(songs.size(), f->second));
+		songs.push_back(*it);
+		fresh.erase(f);
+		++updated;
+	}
+	for (ByFile::const_iterator it = fresh.begin(); it != fresh.end(); ++it) {
+		it->second->randomIdx = rand();
+		parsed.push_back(std::make_pair(songs.size(), it->second));
+		songs.push_back(SongMeta());
+	}
+	{
+		boost::mutex::scoped_lock l(m_mutex);  // The main thread reads the strings
+		for (std::size_t i = 0; i < parsed.size(); ++i) songs[parsed[i].first] = SongMeta(*parsed[i].second, m_strings);
+	}
+	SearchIndex search;
+	for (Metas::const_iterator it = songs.begin(); it != songs.end(); ++it) search.add(unicodeSearchKey(strFull(*it)));
+	prof("merge");
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		m_songs.swap(songs);
+		m_search.swap(search);
+		m_ranks.clear();
+		++m_generation;
+		m_rebuild = true;
+	}
+	ranks_internal();
+	prof("sort");
+	boost::mutex::scoped_lock l(m_mutex);
+	m_debug << log;
+	m_debug << "songs/info: Song folders changed: " << fresh.size() << " songs added, " << updated << " checked for updates, " << removed << " removed" << std::endl;
+	m_dirty = true;
+	m_loading = false;
 }
 
-// Make std::find work with shared_ptrs and regular pointers
-static bool operator==(boost::shared_ptr<Song> const& a, Song const* b) { return a.get() == b; }
-
-/// restore selection
+/// restore selection (used with m_mutex locked)
 class Songs::RestoreSel {
 	Songs& m_s;
-	Song const* m_sel;
+	std::string m_path, m_filename; ///< Song file of the selection (positions may change, e.g. by a refresh)
   public:
 	/// constructor
-	RestoreSel(Songs& s): m_s(s), m_sel(s.empty() ? NULL : &s.current()) {}
-	/// resets song to given song
-	void reset(Song const* song = NULL) { m_sel = song; }
+	RestoreSel(Songs& s): m_s(s) {
+		if (s.m_filteredIdx.empty()) return;
+		unsigned idx = s.m_filteredIdx[s.math_cover.getTarget()];
+		std::map<unsigned, Loaded>::const_iterator it = s.m_loaded.find(idx);
+		if (it != s.m_loaded.end() && it->second.generation == s.m_filteredGeneration) {
+			m_path = it->second.song->path;
+			m_filename = it->second.song->filename;
+		} else if (s.m_filteredGeneration == s.m_generation && idx < s.m_songs.size()) {
+			m_path = s.m_strings.str(s.m_songs[idx].path);
+			m_filename = s.m_strings.str(s.m_songs[idx].filename);
+		}
+	}
 	~RestoreSel() {
 		int pos = 0;
-		if (m_sel) {
-			SongVector& f = m_s.m_filtered;
-			SongVector::iterator it = std::find(f.begin(), f.end(), m_sel);
+		if (!m_filename.empty()) {
+			StringPool::Id path, filename;
+			if (m_s.m_strings.find(m_path, path) && m_s.m_strings.find(m_filename, filename)) {
+				Indices const& f = m_s.m_filteredIdx;
+				for (std::size_t i = 0; i < f.size(); ++i) {
+					SongMeta const& song = m_s.m_songs[f[i]];
+					if (song.path == path && song.filename == filename) { pos = i; break; }
+				}
+			}
 			m_s.math_cover.setTarget(0, 0);
-			if (it != f.end()) pos = it - f.begin();
 		}
 		m_s.math_cover.setTarget(pos, m_s.size());
 	}
 };
 
 void Songs::update() {
-	if (m_dirty && m_updateTimer.get() > 0.5) filter_internal(); // Update with newly loaded songs
+	if (!m_loading && m_watcher) {
+		SongWatcher::Dirs dirs = m_watcher->changes();
+		if (!dirs.empty()) {
+			// Update the changed folders in the background
+			m_loading = true;
+			m_thread->join();
+			m_thread.reset(new boost::thread(boost::bind(&Songs::refresh_internal, boost::ref(*this), dirs)));
+		}
+	}
+	// Update with newly loaded songs (immediately if the list was replaced, as positions have changed)
+	if (m_dirty && (m_rebuild || m_updateTimer.get() > 0.5)) {
+		if (m_rebuild) filter_internal();
+		else merge_internal();
+	}
+	unload();
 	// A hack to move to the first song when the song screen is entered the first time
 	static bool first = true;
 	if (first) { first = false; math_cover.setTarget(0, 0); math_cover.setTarget(0, size()); }
@@ -139,6 +367,20 @@ void Songs::setTypeFilter(unsigned char filter) {
 	filter_internal();
 }
 
+bool Songs::typeMatch(SongMeta const& s) const {
+	if ((m_typeFilter & 1) && !s.has(SongMeta::DANCE)) return false;
+	if ((m_typeFilter & 2) && !s.has(SongMeta::DRUMS)) return false;
+	if ((m_typeFilter & 4) && !s.has(SongMeta::GUITARS)) return false;
+	if ((m_typeFilter & 8) && !s.has(SongMeta::VOCALS)) return false;
+	if ((m_typeFilter & 16) && !s.has(SongMeta::KEYBOARD)) return false;
+	return true;
+}
+
+std::string Songs::strFull(SongMeta const& s) const {
+	// Same as Song::strFull
+	return m_strings.str(s.title) + "\n" + m_strings.str(s.artist) + "\n" + m_strings.str(s.genre) + "\n" + m_strings.str(s.edition) + "\n" + m_strings.str(s.path);
+}
+
 void Songs::filter_internal() {
 	m_updateTimer.setValue(0.0);
 	boost::mutex::scoped_lock l(m_mutex);
@@ -149,45 +391,110 @@ void Songs::filter_internal() {
 	}
 	m_dirty = false;
 	RestoreSel restore(*this);
+	m_rebuild = false;
+	m_merged = m_songs.size();
+	m_filteredGeneration = m_generation;
 	try {
-		SongVector filtered;
-		for (SongVector::const_iterator it = m_songs.begin(); it != m_songs.end(); ++it) {
-			Song& s = **it;
-			if ((m_typeFilter & 1) && !s.hasDance()) continue;
-			if ((m_typeFilter & 2) && !s.hasDrums()) continue;
-			if ((m_typeFilter & 4) && !s.hasGuitars()) continue;
-			if ((m_typeFilter & 8) && !s.hasVocals()) continue;
-			if ((m_typeFilter & 16) && !s.hasKeyboard()) continue;
-			if (regex_search(s.strFull(), boost::regex(m_filter, boost::regex_constants::icase))) filtered.push_back(*it);
+		Indices filtered;
+		if (config["game/search_regex"].b()) {
+			// Slow mode: full regular expression over the song information
+			boost::regex expression(m_filter, boost::regex_constants::icase);
+			for (unsigned i = 0; i < m_songs.size(); ++i) {
+				if (typeMatch(m_songs[i]) && regex_search(strFull(m_songs[i]), expression)) filtered.push_back(i);
+			}
+		} else {
+			SearchIndex::Results const& found = m_search.find(unicodeSearchKey(m_filter));
+			for (SearchIndex::Results::const_iterator it = found.begin(); it != found.end(); ++it) {
+				if (typeMatch(m_songs[*it])) filtered.push_back(*it);
+			}
 		}
-		m_filtered.swap(filtered);
+		m_filteredIdx.swap(filtered);
 	} catch (...) {
-		SongVector(m_songs.begin(), m_songs.end()).swap(m_filtered);  // Invalid regex => copy everything
+		// Invalid regex => copy everything
+		m_filteredIdx.resize(m_songs.size());
+		for (unsigned i = 0; i < m_songs.size(); ++i) m_filteredIdx[i] = i;
 	}
 	math_cover.reset();
 	sort_internal();
 }
 
+void Songs::merge_internal() {
+	m_updateTimer.setValue(0.0);
+	boost::mutex::scoped_lock l(m_mutex);
+	if (m_rebuild) {
+		// Replaced while we were not looking
+		l.unlock();
+		filter_internal();
+		return;
+	}
+	// Print messages when loading has finished
+	if (!m_loading) {
+		std::clog << m_debug.str();
+		m_debug.str(""); m_debug.clear();
+	}
+	m_dirty = false;
+	RestoreSel restore(*this);
+	// Filter and sort only the songs added since the previous update
+	Indices delta;
+	bool regex = config["game/search_regex"].b();
+	std::string key = unicodeSearchKey(m_filter);
+	boost::regex expression;
+	try { if (regex) expression.assign(m_filter, boost::regex_constants::icase); } catch (...) { regex = false; key.clear(); }  // Invalid regex => match everything
+	for (unsigned i = m_merged; i < m_songs.size(); ++i) {
+		if (!typeMatch(m_songs[i])) continue;
+		if (regex ? regex_search(strFull(m_songs[i]), expression) : m_search.match(i, key)) delta.push_back(i);
+	}
+	m_merged = m_songs.size();
+	if (delta.empty()) return;
+	sortIndices(delta);
+	// Merge into the current view (linear)
+	Indices merged;
+	mergeIndices(m_filteredIdx, delta, merged);
+	m_filteredIdx.swap(merged);
+}
+
 namespace {
 
-	/// A functor that compares songs based on a selected member field of them.
-	template<typename Field> class CmpByField {
-		Field Song::* m_field;
+	/// A functor that compares positions in a song list by a field of the songs
+	template<typename Field> class CmpIdxByField {
+		std::vector<SongMeta> const& m_songs;
+		StringPool const& m_strings;
+		Field SongMeta::* m_field;
+		bool less(int left, int right) const { return left < right; }
+		bool less(StringPool::Id left, StringPool::Id right) const { return m_strings.less(left, right); }
 	  public:
-		/** @param field a pointer to the field to use (pointer to member) **/
-		CmpByField(Field Song::* field): m_field(field) {}
-		/// Compare left < right
-		bool operator()(Song const& left , Song const& right) {
-		    return left.*m_field < right.*m_field;
-		}
-		/// Compare *left < *right
-		bool operator()(boost::shared_ptr<Song> const& left, boost::shared_ptr<Song> const& right) {
-			return operator()(*left, *right);
-		}
+		CmpIdxByField(std::vector<SongMeta> const& songs, StringPool const& strings, Field SongMeta::* field): m_songs(songs), m_strings(strings), m_field(field) {}
+		bool operator()(unsigned left, unsigned right) const { return less(m_songs[left].*m_field, m_songs[right].*m_field); }
 	};
 
-    /// A helper for easily constructing CmpByField objects
-    template <typename T> CmpByField<T> comparator(T Song::*field) { return CmpByField<T>(field); }
+	/// Stable sort of song positions by a field
+	template <typename T> void sortByField(std::vector<unsigned>& idx, std::vector<SongMeta> const& songs, StringPool const& strings, T SongMeta::*field) {
+		std::stable_sort(idx.begin(), idx.end(), CmpIdxByField<T>(songs, strings, field));
+	}
+
+	/// Merge two sorted lists of song positions by a field (ties keep songs of a first).
+	/// Songs of b are placed by binary search, so merging a few songs into a long list takes few comparisons.
+	template <typename T> void mergeByField(std::vector<unsigned> const& a, std::vector<unsigned> const& b, std::vector<unsigned>& out, std::vector<SongMeta> const& songs, StringPool const& strings, T SongMeta::*field) {
+		CmpIdxByField<T> cmp(songs, strings, field);
+		out.clear();
+		out.reserve(a.size() + b.size());
+		std::vector<unsigned>::const_iterator pos = a.begin();
+		for (std::vector<unsigned>::const_iterator it = b.begin(); it != b.end(); ++it) {
+			std::vector<unsigned>::const_iterator next = std::upper_bound(pos, a.end(), *it, cmp);
+			out.insert(out.end(), pos, next);
+			out.push_back(*it);
+			pos = next;
+		}
+		out.insert(out.end(), pos, a.end());
+	}
+
+	/// Sort songs b by a field and merge them into a (sorted by the same field)
+	template <typename T> void addByField(std::vector<unsigned>& a, std::vector<unsigned>& b, std::vector<SongMeta> const& songs, StringPool const& strings, T SongMeta::*field) {
+		sortByField(b, songs, strings, field);
+		std::vector<unsigned> out;
+		mergeByField(a, b, out, songs, strings, field);
+		a.swap(out);
+	}
 
 	std::string pathtrim(std::string path) {
 		std::string::size_type pos = path.rfind('/', path.size() - 1);
@@ -225,28 +532,101 @@ std::string Songs::sortDesc() const {
 void Songs::sortChange(int diff) {
 	m_order = (m_order + diff) % orders;
 	if (m_order < 0) m_order += orders;
+	boost::mutex::scoped_lock l(m_mutex);
+	if (m_rebuild) {
+		// Positions have changed, sorted by the full rebuild
+		l.unlock();
+		filter_internal();
+		return;
+	}
 	RestoreSel restore(*this);
 	sort_internal();
 }
 
-void Songs::sort_internal() {
+void Songs::sortIndices(Indices& idx) const {
 	switch (m_order) {
-	  case 0: std::stable_sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::randomIdx)); break;
-	  case 1: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::collateByTitle)); break;
-	  case 2: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::collateByArtist)); break;
-	  case 3: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::edition)); break;
-	  case 4: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::genre)); break;
-	  case 5: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::path)); break;
-	  case 6: std::sort(m_filtered.begin(), m_filtered.end(), comparator(&Song::language)); break;
-	  default: throw std::logic_error("Internal error: unknown sort order in Songs::sortChange");
+	  case 0: sortByField(idx, m_songs, m_strings, &SongMeta::randomIdx); break;
+	  case 1: sortByField(idx, m_songs, m_strings, &SongMeta::collateByTitle); break;
+	  case 2: sortByField(idx, m_songs, m_strings, &SongMeta::collateByArtist); break;
+	  case 3: sortByField(idx, m_songs, m_strings, &SongMeta::edition); break;
+	  case 4: sortByField(idx, m_songs, m_strings, &SongMeta::genre); break;
+	  case 5: sortByField(idx, m_songs, m_strings, &SongMeta::path); break;
+	  case 6: sortByField(idx, m_songs, m_strings, &SongMeta::language); break;
+	  default: throw std::logic_error("Internal error: unknown sort order in Songs::sortIndices");
+	}
+}
+
+void Songs::mergeIndices(Indices const& a, Indices const& b, Indices& out) const {
+	switch (m_order) {
+	  case 0: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::randomIdx); break;
+	  case 1: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::collateByTitle); break;
+	  case 2: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::collateByArtist); break;
+	  case 3: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::edition); break;
+	  case 4: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::genre); break;
+	  case 5: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::path); break;
+	  case 6: mergeByField(a, b, out, m_songs, m_strings, &SongMeta::language); break;
+	  default: throw std::logic_error("Internal error: unknown sort order in Songs::mergeIndices");
+	}
+}
+
+void Songs::computeRanks(Metas const& songs, StringPool const& strings, int order, Indices& rank) {
+	// Songs are only appended to m_songs (a refresh replaces it and drops the ranks), so existing ranks
+	// stay valid and only the songs added since need sorting. After that any subset can be ordered in linear time.
+	if (rank.size() > songs.size()) rank.clear();
+	Indices idx(rank.size());  // Songs already ranked, in order
+	for (unsigned i = 0; i < rank.size(); ++i) idx[rank[i]] = i;
+	Indices added(songs.size() - rank.size());
+	for (unsigned i = 0; i < added.size(); ++i) added[i] = rank.size() + i;
+	switch (order) {
+	  case 0: addByField(idx, added, songs, strings, &SongMeta::randomIdx); break;
+	  case 1: addByField(idx, added, songs, strings, &SongMeta::collateByTitle); break;
+	  case 2: addByField(idx, added, songs, strings, &SongMeta::collateByArtist); break;
+	  case 3: addByField(idx, added, songs, strings, &SongMeta::edition); break;
+	  case 4: addByField(idx, added, songs, strings, &SongMeta::genre); break;
+	  case 5: addByField(idx, added, songs, strings, &SongMeta::path); break;
+	  case 6: addByField(idx, added, songs, strings, &SongMeta::language); break;
+	  default: throw std::logic_error("Internal error: unknown sort order in Songs::computeRanks");
+	}
+	rank.resize(idx.size());
+	for (unsigned i = 0; i < idx.size(); ++i) rank[idx[i]] = i;
+}
+
+void Songs::ranks_internal() {
+	// Only the loader thread modifies m_songs, so the sorting can be done without locking
+	std::vector<Indices> ranks;
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		ranks = m_ranks;  // The order being browsed has usually been ranked already
+	}
+	ranks.resize(orders);
+	for (int order = 0; order < orders; ++order) computeRanks(m_songs, m_strings, order, ranks[order]);
+	boost::mutex::scoped_lock l(m_mutex);
+	m_ranks.swap(ranks);
+}
+
+Songs::Indices const& Songs::ranks(int order) {
+	m_ranks.resize(orders);
+	Indices& rank = m_ranks[order];
+	if (rank.size() != m_songs.size()) computeRanks(m_songs, m_strings, order, rank);  // Songs were added since (only the new ones are sorted)
+	return rank;
+}
+
+void Songs::sort_internal() {
+	Indices const& rank = ranks(m_order);
+	// Counting sort: ranks are distinct, so each song simply goes to its own slot
+	std::vector<int> slots(m_songs.size(), -1);
+	for (Indices::const_iterator it = m_filteredIdx.begin(); it != m_filteredIdx.end(); ++it) slots[rank[*it]] = *it;
+	m_filteredIdx.clear();
+	for (std::vector<int>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+		if (*it >= 0) m_filteredIdx.push_back(*it);
 	}
 }
 
 namespace {
-	void dumpCover(xmlpp::Element* song, Song const& s, size_t num) {
+	void dumpCover(xmlpp::Element* song, std::string const& path, std::string const& coverfile, size_t num) {
 		try {
-			std::string ext = s.cover.substr(s.cover.rfind('.'));
-			fs::path cover = s.path + s.cover;
+			std::string ext = coverfile.substr(coverfile.rfind('.'));
+			fs::path cover = path + coverfile;
 			if (fs::exists(cover)) {
 				std::string coverlink = "covers/" + (boost::format("%|04|") % num).str() + ext;
 				if (fs::is_symlink(coverlink)) fs::remove(coverlink);
@@ -257,31 +637,95 @@ namespace {
 			std::cerr << "Songlist error handling cover image: " << e.what() << std::endl;
 		}
 	}
-	template <typename SongVector> void dumpXML(SongVector const& svec, std::string const& filename) {
-		xmlpp::Document doc;
-		xmlpp::Element* songlist = doc.create_root_node("songlist");
-		songlist->set_attribute("size", boost::lexical_cast<std::string>(svec.size()));
-		for (size_t i = 0; i < svec.size(); ++i) {
-			Song const& s = *svec[i];
-			xmlpp::Element* song = songlist->add_child("song");
-			song->set_attribute("num", boost::lexical_cast<std::string>(i + 1));
-			xmlpp::Element* collate = song->add_child("collate");
-			collate->add_child("artist")->set_child_text(s.collateByArtist);
-			collate->add_child("title")->set_child_text(s.collateByTitle);
-			song->add_child("artist")->set_child_text(s.artist);
-			song->add_child("title")->set_child_text(s.title);
-			if (!s.cover.empty()) dumpCover(song, s, i + 1);
-		}
-		doc.write_to_file_formatted(filename, "UTF-8");
-	}
 }
 
 void Songs::dumpSongs_internal() const {
 	if (m_songlist.empty()) return;
-	SongVector svec = m_songs;
-	std::sort(svec.begin(), svec.end(), comparator(&Song::collateByArtist));
+	Indices idx(m_songs.size());
+	for (unsigned i = 0; i < idx.size(); ++i) idx[i] = i;
+	sortByField(idx, m_songs, m_strings, &SongMeta::collateByArtist);
 	fs::path coverpath = fs::path(m_songlist) / "covers";
 	fs::create_directories(coverpath);
-	dumpXML(svec, m_songlist + "/songlist.xml");
+	xmlpp::Document doc;
+	xmlpp::Element* songlist = doc.create_root_node("songlist");
+	songlist->set_attribute("size", boost::lexical_cast<std::string>(idx.size()));
+	for (size_t i = 0; i < idx.size(); ++i) {
+		SongMeta const& s = m_songs[idx[i]];
+		xmlpp::Element* song = songlist->add_child("song");
+		song->set_attribute("num", boost::lexical_cast<std::string>(i + 1));
+		xmlpp::Element* collate = song->add_child("collate");
+		collate->add_child("artist")->set_child_text(m_strings.str(s.collateByArtist));
+		collate->add_child("title")->set_child_text(m_strings.str(s.collateByTitle));
+		song->add_child("artist")->set_child_text(m_strings.str(s.artist));
+		song->add_child("title")->set_child_text(m_strings.str(s.title));
+		if (s.cover) dumpCover(song, m_strings.str(s.path), m_strings.str(s.cover), i + 1);
+	}
+	doc.write_to_file_formatted(m_songlist + "/songlist.xml", "UTF-8");
 }
 
+boost::shared_ptr<Song> Songs::song(unsigned idx) const {
+	boost::mutex::scoped_lock l(m_mutex);
+	Loaded& entry = m_loaded[idx];
+	entry.used = ++m_used;
+	if (entry.song && entry.generation == m_filteredGeneration) return entry.song;
+	if (entry.song) m_retired.push_back(entry.song);
+	entry.generation = m_filteredGeneration;
+	if (m_filteredGeneration == m_generation && idx < m_songs.size()) entry.song = load_internal(idx);
+	else entry.song.reset(new Song(std::string(), std::string(), Song::Restored()));  // The song list was just replaced, shown until the next update
+	return entry.song;
+}
+
+boost::shared_ptr<Song> Songs::load_internal(unsigned idx) const {
+	// Song files are never parsed here (this runs in the main thread), the notes are only loaded for playing
+	SongMeta const& meta = m_songs[idx];
+	std::string path = m_strings.str(meta.path);
+	std::string filename = m_strings.str(meta.filename);
+	boost::shared_ptr<Song> s;
+	try {
+		// As of the last scan (a stat per song would stall browsing on slow disks); playing parses the file anyway
+		if (m_index && m_index->restore(path, filename, s) && s) {
+			s->randomIdx = meta.randomIdx;
+			return s;
+		}
+	} catch (std::exception& e) {
+		std::clog << "songs/warning: Cannot load " << path << filename << ": " << e.what() << std::endl;
+	}
+	// During a scan, the songs parsed by the scanner are used instead
+	if (idx < m_scanned.size()) return m_scanned[idx];
+	// Removed or changed since scanning (a refresh follows), use what is known about it
+	return fromMeta(meta);
+}
+
+boost::shared_ptr<Song> Songs::fromMeta(SongMeta const& meta) const {
+	boost::shared_ptr<Song> s(new Song(m_strings.str(meta.path), m_strings.str(meta.filename), Song::Restored()));
+	s->title = m_strings.str(meta.title);
+	s->artist = m_strings.str(meta.artist);
+	s->edition = m_strings.str(meta.edition);
+	s->genre = m_strings.str(meta.genre);
+	s->language = m_strings.str(meta.language);
+	s->cover = m_strings.str(meta.cover);
+	s->collateUpdate();
+	s->randomIdx = meta.randomIdx;
+	s->loadStatus = Song::HEADER;
+	return s;
+}
+
+namespace {
+	typedef std::pair<unsigned long, unsigned> LoadedUse; ///< Last use, position
+}
+
+void Songs::unload() {
+	// Only done here, so that references to songs taken during a frame remain valid
+	m_retired.clear();
+	for (std::map<unsigned, Loaded>::iterator it = m_loaded.begin(); it != m_loaded.end();) {
+		if (it->second.generation != m_filteredGeneration) m_loaded.erase(it++);
+		else ++it;
+	}
+	if (m_loaded.size() <= LOADED_MAX) return;
+	// Drop the least recently used songs
+	std::vector<LoadedUse> uses;
+	for (std::map<unsigned, Loaded>::const_iterator it = m_loaded.begin(); it != m_loaded.end(); ++it) uses.push_back(LoadedUse(it->second.used, it->first));
+	std::size_t drop = uses.size() - LOADED_MAX;
+	std::nth_element(uses.begin(), uses.begin() + drop, uses.end());
+	for (std::size_t i = 0; i < drop; ++i) m_loaded.erase(uses[i].second);
+}
@@ -2,15 +2,21 @@
 
 #include "animvalue.hh"
 #include "fs.hh"
+#include "searchindex.hh"
+#include "songmeta.hh"
+#include "songwatcher.hh"
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <map>
 #include <set>
 #include <sstream>
 #include <vector>
 
 class Song;
+class SongIndex;
+class SongScanner;
 class Database;
 
 /// songs class for songs screen
@@ -23,18 +29,20 @@ class Songs: boost::noncopyable {
 	void update();
 	/// reloads songlist
 	void reload();
+	/// is the song list being loaded or refreshed in the background
+	bool loading() const { return m_loading; }
 	/// array access
-	Song& operator[](std::size_t pos) { return *m_filtered[pos]; }
+	Song& operator[](std::size_t pos) { return *song(m_filteredIdx[pos]); }
 	/// number of songs
-	int size() const { return m_filtered.size(); };
+	int size() const { return m_filteredIdx.size(); };
 	/// true if empty
-	int empty() const { return m_filtered.empty(); };
+	int empty() const { return m_filteredIdx.empty(); };
 	/// advances to next song
 	void advance(int diff) {
-		int size = m_filtered.size();
+		int size = m_filteredIdx.size();
 		if (size == 0) return;  // Do nothing if no songs are available
 		int _current = size ? (int(math_cover.getTarget()) + diff) % size : 0;
-		if (_current < 0) _current += m_filtered.size();
+		if (_current < 0) _current += m_filteredIdx.size();
 		math_cover.setTarget(_current,this->size());
 	}
 	/// get current id
@@ -46,11 +54,11 @@ class Songs: boost::noncopyable {
 	/// sets margins for animation
 	void setAnimMargins(double left, double right) { math_cover.setMargins(left, right); }
 	/// @return current song
-	boost::shared_ptr<Song> currentPtr() { return m_filtered.empty() ? boost::shared_ptr<Song>() : m_filtered[math_cover.getTarget()]; }
+	boost::shared_ptr<Song> currentPtr() { return m_filteredIdx.empty() ? boost::shared_ptr<Song>() : song(m_filteredIdx[math_cover.getTarget()]); }
 	/// @return current song
-	Song& current() { return *m_filtered[math_cover.getTarget()]; }
+	Song& current() { return *song(m_filteredIdx[math_cover.getTarget()]); }
 	/// @return current Song
-	Song const& current() const { return *m_filtered[math_cover.getTarget()]; }
+	Song const& current() const { return *song(m_filteredIdx[math_cover.getTarget()]); }
 	/// filters songlist by regular expression
 	void setFilter(std::string const& regex);
 	/// filters songlist by instrument type (bitmask)
@@ -67,24 +75,63 @@ class Songs: boost::noncopyable {
   private:
 	class RestoreSel;
 	typedef std::vector<boost::shared_ptr<Song> > SongVector;
+	typedef std::vector<SongMeta> Metas;
+	typedef std::vector<unsigned> Indices; ///< Positions in m_songs
 	std::string m_songlist;
-	SongVector m_songs, m_filtered;
+	Metas m_songs; ///< All songs (compact information only)
+	StringPool m_strings; ///< Strings of m_songs
+	Indices m_filteredIdx; ///< Songs shown, as positions in m_songs
+	unsigned m_merged; ///< Number of songs of m_songs already considered for m_filteredIdx
+	bool m_rebuild; ///< m_songs was replaced, m_filteredIdx needs a full rebuild
+	std::vector<Indices> m_ranks; ///< Position of each song of m_songs in each sort order, computed on demand
+	static void computeRanks(Metas const& songs, StringPool const& strings, int order, Indices& rank);
+	void ranks_internal();
+	Indices const& ranks(int order);
 	AnimValue m_updateTimer;
 	AnimAcceleration math_cover;
 	std::string m_filter;
+	SearchIndex m_search; ///< Search keys of m_songs (in the same order)
 	unsigned char m_typeFilter;
 	Database & m_database;
 	int m_order;
 	void dumpSongs_internal() const;
 	void reload_internal();
-	void reload_internal(fs::path const& p);
+	void reload_internal(fs::path const& p, SongScanner& scanner, std::ostream& log);
+	void addSongs_internal(SongVector& songs, std::string const& log);
+	void log_internal(std::string const& log); ///< add to m_debug (locks m_mutex)
+	std::size_t songCount_internal() const; ///< size of m_songs (locks m_mutex, the scanner threads add to it)
+	void refresh_internal(SongWatcher::Dirs const& dirs);
 	void randomize_internal();
+	bool typeMatch(SongMeta const& s) const;
+	std::string strFull(SongMeta const& s) const;
 	void filter_internal();
+	void merge_internal();
+	void sortIndices(Indices& idx) const;
+	void mergeIndices(Indices const& a, Indices const& b, Indices& out) const;
 	void sort_internal();
 	volatile bool m_dirty;
 	volatile bool m_loading;
 	std::stringstream m_debug;
 	boost::scoped_ptr<boost::thread> m_thread;
+	boost::scoped_ptr<SongWatcher> m_watcher;
 	mutable boost::mutex m_mutex;
+	// Full songs are loaded (from the song index or the song file) when they are accessed
+	boost::shared_ptr<Song> song(unsigned idx) const;
+	boost::shared_ptr<Song> load_internal(unsigned idx) const;
+	boost::shared_ptr<Song> fromMeta(SongMeta const& meta) const;
+	void unload();
+	struct Loaded {
+		unsigned generation;
+		unsigned long used; ///< Value of m_used when last accessed
+		boost::shared_ptr<Song> song;
+		Loaded(): generation(), used() {}
+	};
+	mutable std::map<unsigned, Loaded> m_loaded; ///< Loaded songs by position in m_songs (main thread only)
+	mutable unsigned long m_used; ///< Access counter for evicting the least recently used songs
+	SongVector m_scanned; ///< Songs parsed by the scan in progress, by position in m_songs (until m_index is available)
+	mutable SongVector m_retired; ///< Outdated loaded songs, kept until the next update() as they may still be referenced
+	unsigned m_generation; ///< Incremented whenever the positions of m_songs change
+	unsigned m_filteredGeneration; ///< m_generation that m_filteredIdx refers to
+	boost::scoped_ptr<SongIndex> m_index; ///< The song index written by the last complete scan
 };
 
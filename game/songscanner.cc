@@ -0,0 +1,131 @@
+#include "songscanner.hh"
+
+#include "song.hh"
+#include "songindex.hh"
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <sstream>
+
+namespace {
+	const std::size_t BATCH_SIZE = 64;  ///< Songs delivered to the sink at once
+}
+
+SongScanner::SongScanner(SongIndex& index, Sink const& sink, volatile bool const& running, unsigned threads):
+  m_index(index), m_sink(sink), m_running(running), m_queued(), m_pending(), m_quit(), m_seq(), m_next()
+{
+	if (threads == 0) threads = std::max(1u, boost::thread::hardware_concurrency());
+	for (unsigned i = 0; i < threads; ++i) m_workers.push_back(new Worker());
+	for (unsigned i = 0; i < threads; ++i) m_threads.create_thread(boost::bind(&SongScanner::run, this, i));
+}
+
+SongScanner::~SongScanner() {
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		m_quit = true;
+	}
+	m_cond.notify_all();
+	m_threads.join_all();
+}
+
+void SongScanner::add(std::string const& path, std::string const& name) {
+	std::size_t seq = m_seq++;
+	{
+		// Count the job before it becomes visible so that takers never see it uncounted
+		boost::mutex::scoped_lock l(m_mutex);
+		++m_queued;
+		++m_pending;
+	}
+	Worker& w = m_workers[seq % m_workers.size()];
+	{
+		boost::mutex::scoped_lock l(w.mutex);
+		w.queue.push_back(Job(seq, path, name));
+	}
+	m_cond.notify_one();
+}
+
+void SongScanner::finish() {
+	{
+		boost::mutex::scoped_lock l(m_mutex);
+		while (m_pending > 0) m_cond.wait(l);
+	}
+	boost::mutex::scoped_lock l(m_resultMutex);
+	flush();
+}
+
+bool SongScanner::take(std::size_t id, Job& job) {
+	// Own queue first (oldest job), then steal the newest job of another worker
+	for (std::size_t i = 0; i < m_workers.size(); ++i) {
+		Worker& w = m_workers[(id + i) % m_workers.size()];
+		boost::mutex::scoped_lock l(w.mutex);
+		if (w.queue.empty()) continue;
+		if (i == 0) { job = w.queue.front(); w.queue.pop_front(); }
+		else { job = w.queue.back(); w.queue.pop_back(); }
+		return true;
+	}
+	return false;
+}
+
+void SongScanner::run(std::size_t id) {
+	Job job(0, std::string(), std::string());
+	while (true) {
+		{
+			boost::mutex::scoped_lock l(m_mutex);
+			while (m_queued == 0 && !m_quit) m_cond.wait(l);
+			if (m_quit) return;
+		}
+		if (!take(id, job)) { boost::this_thread::yield(); continue; }  // Counted but not yet pushed
+		{
+			boost::mutex::scoped_lock l(m_mutex);
+			--m_queued;
+		}
+		Result result;
+		if (m_running) parse(job, result);
+		deliver(job.seq, result);
+		{
+			boost::mutex::scoped_lock l(m_mutex);
+			--m_pending;
+		}
+		m_cond.notify_all();
+	}
+}
+
+void SongScanner::parse(Job const& job, Result& result) {
+	std::ostringstream log;
+	SongIndex::Stamp stamp;
+	try {
+		stamp = SongIndex::Stamp(job.path + job.name);
+		if (m_index.lookup(job.path, job.name, stamp, result.song)) return;
+		result.song.reset(new Song(job.path, job.name));
+		m_index.store(job.path, job.name, stamp, result.song.get());
+	} catch (SongParserException& e) {
+		result.song.reset();
+		if (e.silent()) { m_index.store(job.path, job.name, stamp, NULL); return; }
+		// Construct error message
+		log << "songs/error: -!- Error in " << job.path << "\n    " << job.name;
+		if (e.line()) log << " line " << e.line();
+		log << ": " << e.what() << std::endl;
+	} catch (std::exception& e) {
+		result.song.reset();
+		log << "songs/error: -!- Error accessing " << job.path << job.name << ": " << e.what() << std::endl;
+	}
+	result.log = log.str();
+}
+
+void SongScanner::deliver(std::size_t seq, Result const& result) {
+	boost::mutex::scoped_lock l(m_resultMutex);
+	m_results[seq] = result;
+	// Move the completed prefix to the current batch
+	for (std::map<std::size_t, Result>::iterator it = m_results.begin(); it != m_results.end() && it->first == m_next; m_results.erase(it++), ++m_next) {
+		if (it->second.song) m_batch.push_back(it->second.song);
+		m_log += it->second.log;
+	}
+	if (m_batch.size() >= BATCH_SIZE) flush();
+}
+
+void SongScanner::flush() {
+	if (m_batch.empty() && m_log.empty()) return;
+	m_sink(m_batch, m_log);
+	m_batch.clear();
+	m_log.clear();
+}
+
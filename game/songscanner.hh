@@ -0,0 +1,86 @@
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class Song;
+class SongIndex;
+
+/**
+* @short Parses song files on a pool of worker threads.
+* The caller enumerates directories and add()s candidate files; each worker has its own
+* queue and steals from the others when it runs dry. Results are handed to the sink in
+* batches, always in the order the files were added, so the outcome does not depend on
+* thread timing.
+**/
+class SongScanner: boost::noncopyable {
+  public:
+	typedef std::vector<boost::shared_ptr<Song> > Batch;
+	/// Receives parsed songs and the log messages produced while parsing them
+	typedef boost::function<void (Batch&, std::string const&)> Sink;
+	/**
+	* @param index song index used to skip parsing of unchanged files
+	* @param sink called (from any thread, but never concurrently) with the results
+	* @param running scanning stops as soon as this becomes false
+	* @param threads number of workers, 0 for one per CPU core
+	**/
+	SongScanner(SongIndex& index, Sink const& sink, volatile bool const& running, unsigned threads = 0);
+	~SongScanner();
+	/// Queue a file for parsing
+	void add(std::string const& path, std::string const& name);
+	/// Wait until all queued files are done and all results have been delivered
+	void finish();
+	/// Number of files queued so far
+	std::size_t files() const { return m_seq; }
+	/// Number of worker threads
+	std::size_t threads() const { return m_workers.size(); }
+
+  private:
+	struct Job {
+		std::size_t seq;
+		std::string path, name;
+		Job(std::size_t s, std::string const& p, std::string const& n): seq(s), path(p), name(n) {}
+	};
+	struct Result {
+		boost::shared_ptr<Song> song;
+		std::string log;
+	};
+	struct Worker {
+		boost::mutex mutex;
+		std::deque<Job> queue;
+	};
+	void run(std::size_t id);
+	bool take(std::size_t id, Job& job);
+	void parse(Job const& job, Result& result);
+	void deliver(std::size_t seq, Result const& result);
+	void flush();
+	SongIndex& m_index;
+	Sink m_sink;
+	volatile bool const& m_running;
+	boost::ptr_vector<Worker> m_workers;
+	boost::thread_group m_threads;
+	// Job accounting (for sleeping workers and finish)
+	boost::mutex m_mutex;
+	boost::condition m_cond;
+	std::size_t m_queued; ///< Jobs added but not yet taken
+	std::size_t m_pending; ///< Jobs added but not yet delivered
+	bool m_quit;
+	std::size_t m_seq;
+	// Ordered delivery of results
+	boost::mutex m_resultMutex;
+	std::map<std::size_t, Result> m_results; ///< Completed results waiting for earlier ones
+	std::size_t m_next; ///< Sequence number of the next result to deliver
+	Batch m_batch;
+	std::string m_log;
+};
+
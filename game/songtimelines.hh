@@ -0,0 +1,25 @@
+#pragma once
+
+#include "dancegraph.hh"
+#include "guitargraph.hh"
+#include <map>
+#include <string>
+#include <utility>
+
+/**
+* @short Note timelines of a song, computed ahead by SongPreload.
+* The graphs copy these instead of building their initial timelines while ScreenSing is entered.
+* Chords point to the notes of the song, so the timelines are only valid with the Song holding them.
+**/
+struct SongTimelines {
+	typedef std::pair<std::string, int> Key; ///< Track name or dance game mode, difficulty level
+	typedef std::map<Key, ChordTimeline> ChordTimelines;
+	typedef std::map<Key, DanceNotes> DanceTimelines;
+	ChordTimelines chords; ///< For GuitarGraph
+	DanceTimelines dance; ///< For DanceGraph
+	/// Get a timeline, or NULL if it was not prepared
+	template <typename Map> static typename Map::mapped_type const* find(Map const& map, std::string const& name, int level) {
+		typename Map::const_iterator it = map.find(Key(name, level));
+		return it == map.end() ? NULL : &it->second;
+	}
+};
@@ -0,0 +1,175 @@
+#include "songwatcher.hh"
+
+#include <boost/bind.hpp>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+	const double SETTLE_TIME = 2.0;  ///< Seconds without further changes before a directory is reported
+	const double POLL_INTERVAL = 10.0;  ///< Seconds between polling rounds
+	const unsigned MAX_DEPTH = 20;  ///< Same cyclic symlink guard as in song scanning
+
+	std::time_t mtime(std::string const& path) {
+		try { return fs::last_write_time(path); } catch (std::exception&) { return 0; }
+	}
+}
+
+std::string SongWatcher::dirKey(fs::path const& dir) {
+	std::string str = dir.string();
+	if (str.empty() || str[str.size() - 1] != '/') str += '/';
+	return str;
+}
+
+SongWatcher::SongWatcher(Paths const& roots, std::vector<std::string> const& files):
+  m_roots(roots), m_files(files), m_quit(), m_fd(-1)
+{
+	m_thread.reset(new boost::thread(boost::bind(&SongWatcher::run, this)));
+}
+
+SongWatcher::~SongWatcher() {
+	m_quit = true;
+	m_thread->join();
+#ifdef __linux__
+	if (m_fd != -1) close(m_fd);
+#endif
+}
+
+SongWatcher::Dirs SongWatcher::changes() {
+	Dirs dirs;
+	boost::xtime t = now();
+	boost::mutex::scoped_lock l(m_mutex);
+	for (std::map<std::string, boost::xtime>::iterator it = m_changes.begin(); it != m_changes.end();) {
+		if (t - it->second < SETTLE_TIME) { ++it; continue; }
+		dirs.insert(it->first);
+		m_changes.erase(it++);
+	}
+	return dirs;
+}
+
+void SongWatcher::mark(std::string const& dir) {
+	boost::mutex::scoped_lock l(m_mutex);
+	m_changes[dir] = now();
+}
+
+void SongWatcher::run() {
+	try {
+		if (inotifyInit()) { inotifyRun(); return; }
+	} catch (std::exception& e) {
+		std::clog << "songwatcher/warning: inotify failed, polling for changes instead: " << e.what() << std::endl;
+	}
+#ifdef __linux__
+	if (m_fd != -1) { close(m_fd); m_fd = -1; m_watches.clear(); }
+#endif
+	pollRun();
+}
+
+#ifdef __linux__
+bool SongWatcher::inotifyInit() {
+	m_fd = inotify_init();
+	if (m_fd == -1) return false;
+	for (Paths::const_iterator it = m_roots.begin(); !m_quit && it != m_roots.end(); ++it) {
+		if (fs::is_directory(*it)) inotifyAdd(dirKey(*it));
+	}
+	return true;
+}
+
+void SongWatcher::inotifyAdd(std::string const& dir) {
+	if (std::distance(fs::path(dir).begin(), fs::path(dir).end()) > int(MAX_DEPTH)) return;
+	int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+	if (wd == -1) {
+		if (errno == ENOSPC) throw std::runtime_error("Too many folders for inotify (see /proc/sys/fs/inotify/max_user_watches)");
+		return;  // Unreadable folder or a race with removal, nothing to watch
+	}
+	m_watches[wd] = dir;
+	for (fs::directory_iterator dirIt(dir), dirEnd; !m_quit && dirIt != dirEnd; ++dirIt) {
+		if (fs::is_directory(dirIt->path())) inotifyAdd(dirKey(dirIt->path()));
+	}
+}
+
+void SongWatcher::inotifyRun() {
+	std::vector<char> buf(65536);
+	while (!m_quit) {
+		pollfd pfd = { m_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 500) <= 0) continue;  // Timeout (check m_quit) or interrupted
+		ssize_t len = read(m_fd, &buf[0], buf.size());
+		if (len <= 0) continue;
+		for (char* ptr = &buf[0]; ptr < &buf[0] + len;) {
+			inotify_event const* ev = reinterpret_cast<inotify_event const*>(ptr);
+			ptr += sizeof(inotify_event) + ev->len;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				// Events were lost, everything needs checking
+				for (std::map<int, std::string>::const_iterator it = m_watches.begin(); it != m_watches.end(); ++it) mark(it->second);
+				continue;
+			}
+			std::map<int, std::string>::iterator it = m_watches.find(ev->wd);
+			if (it == m_watches.end()) continue;
+			std::string dir = it->second;
+			if (ev->mask & IN_IGNORED) { m_watches.erase(it); continue; }  // Watched folder is gone
+			if (ev->mask & IN_DELETE_SELF) { mark(dir); continue; }
+			if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) && ev->len) {
+				try { inotifyAdd(dir + ev->name + '/'); } catch (std::exception& e) { std::clog << "songwatcher/warning: " << e.what() << std::endl; }
+			}
+			mark(dir);
+		}
+	}
+}
+#else
+bool SongWatcher::inotifyInit() { return false; }
+void SongWatcher::inotifyAdd(std::string const&) {}
+void SongWatcher::inotifyRun() {}
+#endif
+
+void SongWatcher::pollAdd(std::string const& dir) {
+	if (std::distance(fs::path(dir).begin(), fs::path(dir).end()) > int(MAX_DEPTH)) return;
+	m_dirTimes[dir] = mtime(dir);
+	try {
+		for (fs::directory_iterator dirIt(dir), dirEnd; !m_quit && dirIt != dirEnd; ++dirIt) {
+			if (fs::is_directory(dirIt->path())) pollAdd(dirKey(dirIt->path()));
+		}
+	} catch (std::exception&) {}  // Unreadable folder, only its own mtime is watched
+}
+
+void SongWatcher::pollRun() {
+	for (Paths::const_iterator it = m_roots.begin(); !m_quit && it != m_roots.end(); ++it) {
+		if (fs::is_directory(*it)) pollAdd(dirKey(*it));
+	}
+	for (std::vector<std::string>::const_iterator it = m_files.begin(); !m_quit && it != m_files.end(); ++it) m_fileTimes[*it] = mtime(*it);
+	boost::xtime next = now() + POLL_INTERVAL;
+	while (!m_quit) {
+		if (next - now() > 0.0) { boost::thread::sleep(now() + 0.5); continue; }
+		// Added, removed and renamed entries change the mtime of the folder
+		std::vector<std::string> changed;
+		for (std::map<std::string, std::time_t>::iterator it = m_dirTimes.begin(); !m_quit && it != m_dirTimes.end(); ++it) {
+			std::time_t t = mtime(it->first);
+			if (t == it->second) continue;
+			it->second = t;
+			changed.push_back(it->first);
+		}
+		for (size_t i = 0; i < changed.size(); ++i) {
+			mark(changed[i]);
+			if (!fs::is_directory(changed[i])) { m_dirTimes.erase(changed[i]); continue; }
+			// Pick up new subfolders
+			try {
+				for (fs::directory_iterator dirIt(changed[i]), dirEnd; !m_quit && dirIt != dirEnd; ++dirIt) {
+					std::string dir = dirKey(dirIt->path());
+					if (fs::is_directory(dir) && m_dirTimes.find(dir) == m_dirTimes.end()) pollAdd(dir);
+				}
+			} catch (std::exception&) {}
+		}
+		// Songs edited in place only change the mtime of the file itself
+		for (std::map<std::string, std::time_t>::iterator it = m_fileTimes.begin(); !m_quit && it != m_fileTimes.end(); ++it) {
+			std::time_t t = mtime(it->first);
+			if (t == it->second) continue;
+			it->second = t;
+			mark(dirKey(fs::path(it->first).parent_path()));
+		}
+		next = now() + POLL_INTERVAL;
+	}
+}
+
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "fs.hh"
+#include "xtime.hh"
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+* @short Watches the song folders for added, modified and removed files.
+* Uses inotify on Linux and falls back to polling directory and song file mtimes
+* elsewhere (or when inotify runs out of watches). Changes are reported per directory,
+* with directory names in the same format as Song::path (trailing slash).
+**/
+class SongWatcher: boost::noncopyable {
+  public:
+	typedef std::set<std::string> Dirs;
+	/**
+	* Start watching.
+	* @param roots folders to watch recursively
+	* @param files song files currently known (watched for modification when polling)
+	**/
+	SongWatcher(Paths const& roots, std::vector<std::string> const& files);
+	~SongWatcher();
+	/// Take the directories that have changed and have since been quiet for a while (so that copying has finished)
+	Dirs changes();
+	/// Convert a directory path into the format used by Song::path
+	static std::string dirKey(fs::path const& dir);
+
+  private:
+	void run();
+	bool inotifyInit();
+	void inotifyAdd(std::string const& dir);
+	void inotifyRun();
+	void pollAdd(std::string const& dir);
+	void pollRun();
+	void mark(std::string const& dir);
+	Paths m_roots;
+	std::vector<std::string> m_files;
+	volatile bool m_quit;
+	boost::mutex m_mutex;
+	std::map<std::string, boost::xtime> m_changes; ///< Changed directory, time of the most recent change
+	// inotify state
+	int m_fd;
+	std::map<int, std::string> m_watches; ///< Watch descriptor to directory
+	// Polling state
+	std::map<std::string, std::time_t> m_dirTimes;
+	std::map<std::string, std::time_t> m_fileTimes;
+	boost::scoped_ptr<boost::thread> m_thread;
+};
+
@@ -0,0 +1,126 @@
+#include "spritebatch.hh"
+
+#include <algorithm>
+
+using namespace glutil;
+
+namespace {
+	const unsigned MAX_QUADS = 16384;  ///< Limited by 16-bit indices
+	SpriteBatch* s_batch = NULL;  ///< The batch that flushSprites() flushes
+
+	bool same(glmath::mat4 const& a, glmath::mat4 const& b) {
+		GLfloat const* pa = a;
+		GLfloat const* pb = b;
+		return std::equal(pa, pa + 16, pb);
+	}
+}
+
+void glutil::flushSprites() {
+	if (s_batch) s_batch->flush();
+}
+
+SpriteBatch::SpriteBatch():
+  m_vbo(), m_ibo(),
+  m_projection(glmath::mat4::identity()), m_modelview(glmath::mat4::identity()), m_color(glmath::mat4::identity()),
+  m_shader(), m_type(), m_texture(),
+  m_batchProjection(glmath::mat4::identity()), m_batchColor(glmath::mat4::identity())
+{
+	m_vertices.reserve(4 * 256);
+	s_batch = this;
+}
+
+SpriteBatch::~SpriteBatch() {
+	if (s_batch == this) s_batch = NULL;
+	if (m_vbo) glDeleteBuffers(1, &m_vbo);
+	if (m_ibo) glDeleteBuffers(1, &m_ibo);
+}
+
+void SpriteBatch::add(Shader& shader, GLenum type, GLuint texture, float x1, float y1, float x2, float y2, float s1, float t1, float s2, float t2) {
+	if (!m_vertices.empty() && (&shader != m_shader || type != m_type || texture != m_texture
+	  || !same(m_projection, m_batchProjection) || !same(m_color, m_batchColor) || m_vertices.size() >= 4 * MAX_QUADS)) flush();
+	if (m_vertices.empty()) {
+		m_shader = &shader;
+		m_type = type;
+		m_texture = texture;
+		m_batchProjection = m_projection;
+		m_batchColor = m_color;
+	}
+	// Same vertex order as a triangle strip (see the index buffer)
+	vertex(x1, y1, s1, t1);
+	vertex(x2, y1, s2, t1);
+	vertex(x1, y2, s1, t2);
+	vertex(x2, y2, s2, t2);
+}
+
+void SpriteBatch::vertex(float x, float y, float s, float t) {
+	glmath::mat4 const& mv = m_modelview;
+	VertexInfo v;
+	v.position = x * mv.cols[0] + y * mv.cols[1] + mv.cols[3];
+	v.texCoord = glmath::vec4(s, t, 0.0f, 0.0f);
+	m_vertices.push_back(v);
+}
+
+void SpriteBatch::flush() {
+	if (m_vertices.empty()) return;
+	GLErrorChecker glerror("SpriteBatch::flush");
+	if (!m_vbo) {
+		glGenBuffers(1, &m_vbo);
+		glGenBuffers(1, &m_ibo);
+		std::vector<GLushort> indices;
+		indices.reserve(6 * MAX_QUADS);
+		for (unsigned i = 0; i < 4 * MAX_QUADS; i += 4) {
+			GLushort quad[] = { GLushort(i), GLushort(i + 1), GLushort(i + 2), GLushort(i + 2), GLushort(i + 1), GLushort(i + 3) };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	// Switch to the state of the batch
+	Shader* oldShader = Shader::current();
+	GLuint oldTexture = boundTexture(m_type);
+	Shader& sh = m_shader->bind();
+	sh.projMatrix.setMat4(m_batchProjection);
+	sh.mvMatrix.setMat4(glmath::mat4::identity());  // Vertices are already in eye space
+	sh.colorMatrix.setMat4(m_batchColor);
+	bindTexture(m_type, m_texture);
+	// Stream the vertices (orphaning the previous contents avoids waiting for earlier draws)
+	std::size_t bytes = m_vertices.size() * sizeof(VertexInfo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &m_vertices[0]);
+	GLint vertPos = sh.vertPos;
+	GLint vertTexCoord = sh.vertTexCoord;
+	GLint vertColor = sh.vertColor;
+	GLsizei stride = sizeof(VertexInfo);
+	char const* base = NULL;
+	if (vertPos != -1) {
+		glEnableVertexAttribArray(vertPos);
+		glVertexAttribPointer(vertPos, 4, GL_FLOAT, GL_FALSE, stride, base);
+	}
+	if (vertTexCoord != -1) {
+		glEnableVertexAttribArray(vertTexCoord);
+		glVertexAttribPointer(vertTexCoord, 4, GL_FLOAT, GL_FALSE, stride, base + sizeof(glmath::vec4));
+	}
+	if (vertColor != -1) {
+		glEnableVertexAttribArray(vertColor);
+		glVertexAttribPointer(vertColor, 4, GL_FLOAT, GL_FALSE, stride, base + 3 * sizeof(glmath::vec4));
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glDrawElements(GL_TRIANGLES, m_vertices.size() / 4 * 6, GL_UNSIGNED_SHORT, NULL);
+	countDrawCall();
+	if (vertPos != -1) glDisableVertexAttribArray(vertPos);
+	if (vertTexCoord != -1) glDisableVertexAttribArray(vertTexCoord);
+	if (vertColor != -1) glDisableVertexAttribArray(vertColor);
+	// VertexArray uses client side arrays, so no buffers may stay bound
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Restore the state
+	sh.projMatrix.setMat4(m_projection);
+	sh.mvMatrix.setMat4(m_modelview);
+	sh.colorMatrix.setMat4(m_color);
+	bindTexture(m_type, oldTexture);
+	Shader::use(oldShader);
+	m_vertices.clear();
+}
+
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "glmath.hh"
+#include "glshader.hh"
+#include <boost/noncopyable.hpp>
+#include <GL/glew.h>
+#include <vector>
+
+namespace glutil {
+	/**
+	* @short Collects textured quads and draws them with as few draw calls as possible.
+	* Quads are transformed into eye space as they are added, so that modelview changes do not
+	* break a batch. Quads sharing shader, texture, projection and color matrix are drawn together
+	* from a single streaming vertex buffer. Code changing any other GL state while quads may be
+	* queued must call flushSprites() first.
+	**/
+	class SpriteBatch: boost::noncopyable {
+	  public:
+		SpriteBatch();
+		~SpriteBatch();
+		/// Queue a quad with corners (x1, y1) and (x2, y2) in modelview space and texture coordinates (s1, t1) and (s2, t2)
+		void add(Shader& shader, GLenum type, GLuint texture, float x1, float y1, float x2, float y2, float s1, float t1, float s2, float t2);
+		/// Draw the queued quads
+		void flush();
+		/// Track the current transforms (the values in the shader uniforms)
+		void transforms(glmath::mat4 const& projection, glmath::mat4 const& modelview) { m_projection = projection; m_modelview = modelview; }
+		/// Track the current color matrix (the value in the shader uniforms)
+		void color(glmath::mat4 const& color) { m_color = color; }
+	  private:
+		void vertex(float x, float y, float s, float t);
+		std::vector<VertexInfo> m_vertices;
+		GLuint m_vbo; ///< Streaming vertex buffer (orphaned on every flush)
+		GLuint m_ibo; ///< Static index buffer for drawing quads as triangles
+		glmath::mat4 m_projection, m_modelview, m_color;
+		// State shared by the queued quads
+		Shader* m_shader;
+		GLenum m_type;
+		GLuint m_texture;
+		glmath::mat4 m_batchProjection, m_batchColor;
+	};
+}
+
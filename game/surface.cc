@@ -6,16 +6,22 @@
 #include "video_driver.hh"
 #include "image.hh"
 #include "screen.hh"
+#include "xtime.hh"
 
+#include <boost/bind.hpp>
 #include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <deque>
 #include <fstream>
+#include <map>
+#include <set>
 #include <stdexcept>
 #include <sstream>
 #include <vector>
 
 #include <cctype>
+#include <cstring>
 
 #include <boost/cstdint.hpp>
 #include <boost/format.hpp>
@@ -25,6 +31,10 @@ Shader& getShader(std::string const& name) {
 	return ScreenManager::getSingletonPtr()->window().shader(name);  // FIXME
 }
 
+glutil::SpriteBatch& getSprites() {
+	return ScreenManager::getSingletonPtr()->window().sprites();
+}
+
 float Dimensions::screenY() const {
 	switch (m_screenAnchor) {
 	  case CENTER: return 0.0;
@@ -34,99 +44,331 @@ float Dimensions::screenY() const {
 	throw std::logic_error("Dimensions::screenY(): unknown m_screenAnchor value");
 }
 
-struct Job {
-	fs::path name;
-	typedef boost::function<void (Bitmap& bitmap)> ApplyFunc;
-	ApplyFunc apply;
-	Bitmap bitmap;
-	Job() {}
-	Job(fs::path const& n, ApplyFunc const& a): name(n), apply(a) {}
-};
+namespace {
+	struct Job {
+		typedef boost::function<void (Bitmap& bitmap)> ApplyFunc;
+		enum State { QUEUED, LOADING, DONE };
+		fs::path name;
+		unsigned thumbnail;  ///< Maximum size of a downscaled image or 0 for full size
+		ApplyFunc apply;
+		LoadPriority priority;
+		unsigned long seq;  ///< Request order (earlier first among equal priority)
+		State state;
+		Bitmap bitmap;
+		Job(): thumbnail(), priority(), seq(), state() {}
+		Job(fs::path const& n, unsigned th, ApplyFunc const& a, LoadPriority p): name(n), thumbnail(th), apply(a), priority(p), seq(), state(QUEUED) {}
+		/// Jobs with the same key share one decode
+		std::string key() const { return thumbnail ? name.string() + (boost::format("#%u") % thumbnail).str() : name.string(); }
+	};
 
-struct Loader {
-	volatile bool m_quit;
-	boost::thread m_thread;
-	boost::mutex m_mutex;
-	boost::condition m_condition;
-	typedef std::map<void const*, Job> Jobs;
-	Jobs m_jobs;
-	Loader(): m_quit(), m_thread(&Loader::run, this) {}
-	~Loader() { m_quit = true; m_condition.notify_one(); m_thread.join(); }
-	void run() {
-		while (!m_quit) {
-			void const* target = NULL;
-			fs::path name;
-			{
-				// Poll for jobs to be done
-				boost::mutex::scoped_lock l(m_mutex);
-				for (Jobs::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it) {
-					if (it->second.name.empty()) continue;  // Job already done
-					name = it->second.name;
-					target = it->first;
-				}
-				// If not found, wait for one
-				if (!target) {
-					m_condition.wait(l);
-					continue;
+	/// Decode an image file
+	void loadBitmap(Bitmap& bitmap, fs::path const& name) {
+		std::string const filename = name.string();
+		if (!fs::exists(name) || fs::is_directory(name)) throw std::runtime_error("File not found: " + filename);
+		else if (filemagic::SVG(name)) loadSVG(bitmap, filename);
+		else if (filemagic::JPEG(name)) loadJPEG(bitmap, filename);
+		else if (filemagic::PNG(name)) loadPNG(bitmap, filename);
+		else throw std::runtime_error("Unable to load the image: " + filename);
+	}
+
+	/// Scale a bitmap down (by averaging) so that it fits in size x size pixels, keeping its aspect ratio
+	void downscale(Bitmap& bitmap, unsigned size) {
+		unsigned const w = bitmap.width, h = bitmap.height;
+		if (w <= size && h <= size) return;
+		unsigned const dw = std::max(1u, w >= h ? size : w * size / h);
+		unsigned const dh = std::max(1u, h >= w ? size : h * size / w);
+		bool const rgb = (bitmap.fmt == pix::RGB || bitmap.fmt == pix::BGR);
+		unsigned const bpp = rgb ? 3 : 4;
+		unsigned const stride = rgb ? (w * 3 + 3) & ~3 : w * 4;  // RGB rows are word-aligned
+		unsigned const dstride = rgb ? (dw * 3 + 3) & ~3 : dw * 4;
+		Bitmap out;
+		out.resize(dw, dh);
+		out.ar = bitmap.ar;
+		out.fmt = bitmap.fmt;
+		std::vector<unsigned> sum(bpp);
+		for (unsigned y = 0; y < dh; ++y) {
+			unsigned const y1 = y * h / dh, y2 = std::max(y1 + 1, (y + 1) * h / dh);
+			for (unsigned x = 0; x < dw; ++x) {
+				unsigned const x1 = x * w / dw, x2 = std::max(x1 + 1, (x + 1) * w / dw);
+				std::fill(sum.begin(), sum.end(), 0);
+				for (unsigned sy = y1; sy < y2; ++sy) {
+					unsigned char const* src = &bitmap.buf[sy * stride + x1 * bpp];
+					for (unsigned i = 0; i < (x2 - x1) * bpp; ++i) sum[i % bpp] += src[i];
 				}
+				unsigned const n = (x2 - x1) * (y2 - y1);
+				unsigned char* dst = &out.buf[y * dstride + x * bpp];
+				for (unsigned c = 0; c < bpp; ++c) dst[c] = (sum[c] + n / 2) / n;
 			}
-			Bitmap bitmap;
-			try {
-				// Load bitmap from disk
-				std::string const filename = name.string();
-				if (!fs::exists(name) || fs::is_directory(name)) throw std::runtime_error("File not found: " + filename);
-				else if (filemagic::SVG(name)) loadSVG(bitmap, filename);
-				else if (filemagic::JPEG(name)) loadJPEG(bitmap, filename);
-				else if (filemagic::PNG(name)) loadPNG(bitmap, filename);
-				else throw std::runtime_error("Unable to load the image: " + filename);
-			} catch (std::exception& e) {
-				std::clog << "image/error: " << e.what() << std::endl;
+		}
+		bitmap.swap(out);
+	}
+
+	/// Decode an image file as a thumbnail, using the thumbnail cache when possible
+	void loadThumbnail(Bitmap& bitmap, fs::path const& name, unsigned size) {
+		if (!fs::exists(name) || fs::is_directory(name)) throw std::runtime_error("File not found: " + name.string());
+		fs::path const cache_filename = cache::constructThumbnailFileName(name, size);
+		if (cache::loadRaw(bitmap, cache_filename, name, size)) return;
+		// JPEGs can be scaled down while decoding, others are decoded at full size
+		if (filemagic::JPEG(name)) loadJPEG(bitmap, name.string(), size); else loadBitmap(bitmap, name);
+		downscale(bitmap, size);
+		cache::saveRaw(bitmap, cache_filename, name, size);
+	}
+
+	/**
+	* @short Ring of pixel buffer objects for the uploads of loaded images (see Loader::apply).
+	* Each image is copied into the next buffer, so the copy overlaps the transfers still running
+	* from the others. A buffer keeps its storage and is only reused after the rest of the ring.
+	* Uploads outside Loader::apply (e.g. video and webcam frames) use client memory instead.
+	**/
+	class Staging {
+	  public:
+		Staging(): m_next(), m_active() {}
+		/// Stages the uploads done during its lifetime (main thread only)
+		struct Scope {
+			Scope(Staging& s): staging(s) { staging.m_active = true; }
+			~Scope() { staging.m_active = false; }
+			Staging& staging;
+		};
+		bool active() const { return m_active; }
+		/// Copy the pixels into the next buffer and leave it bound; returns false if it could not be mapped
+		bool stage(Bitmap const& bitmap) {
+			Buffer& b = m_buffers[m_next];
+			m_next = (m_next + 1) % COUNT;
+			if (!b.id) glGenBuffers(1, &b.id);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, b.id);
+			if (b.size < bitmap.buf.size()) {
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, bitmap.buf.size(), NULL, GL_STREAM_DRAW);
+				b.size = bitmap.buf.size();
+			}
+			void* ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+			if (ptr) {
+				std::memcpy(ptr, &bitmap.buf[0], bitmap.buf.size());
+				if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) return true;
+				b.size = 0;  // Contents lost, reallocate on next use
 			}
-			// Store the result
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return false;
+		}
+	  private:
+		static const unsigned COUNT = 4;
+		struct Buffer {
+			Buffer(): id(), size() {}
+			GLuint id;
+			std::size_t size;
+		};
+		Buffer m_buffers[COUNT];
+		unsigned m_next;
+		bool m_active;
+	} staging;
+}
+
+/**
+* @short Loads images in worker threads, most important first.
+* Jobs are identified by their target (Surface or Texture). Pushing a new job for a target
+* replaces its old one and removing cancels it. Targets waiting for the same file share one decode.
+* Finished bitmaps are loaded into OpenGL by apply(), in the main thread.
+**/
+class Loader {
+  public:
+	Loader(): m_quit(), m_seq(), m_pending(), m_generation() {
+		unsigned threads = std::max(1u, boost::thread::hardware_concurrency());
+		for (unsigned i = 0; i < threads; ++i) m_threads.create_thread(boost::bind(&Loader::run, this));
+	}
+	~Loader() {
+		{
 			boost::mutex::scoped_lock l(m_mutex);
-			Jobs::iterator it = m_jobs.find(target);
-			if (it == m_jobs.end()) continue;  // The job has been removed already
-			it->second.name.clear();  // Mark the job completed
-			it->second.bitmap.swap(bitmap);  // Store the bitmap (if we got any)
+			m_quit = true;
 		}
+		m_condition.notify_all();
+		m_threads.join_all();
 	}
 	void push(void const* t, Job const& job) {
 		boost::mutex::scoped_lock l(m_mutex);
-		m_jobs[t] = job;
+		erase(t);
+		Job& j = m_jobs[t] = job;
+		j.seq = m_seq++;
+		std::string const name = j.key();
+		m_names[name].insert(t);
+		++m_pending;
+		// Join a decode of the same file that is already in progress
+		if (m_loading.find(name) != m_loading.end()) { j.state = Job::LOADING; return; }
+		m_queue.insert(QueueEntry(j, t));
 		m_condition.notify_one();
 	}
 	void remove(void const* t) {
 		boost::mutex::scoped_lock l(m_mutex);
-		m_jobs.erase(t);
+		erase(t);
 	}
-	void apply() {
+	/// Raise the priority of a queued job whose target is being drawn (background images stay last)
+	void touch(void const* t) {
+		if (!m_pending) return;  // Nothing is loading (unlocked read, only a hint)
 		boost::mutex::scoped_lock l(m_mutex);
-		for (Jobs::iterator it = m_jobs.begin(); it != m_jobs.end();) {
+		Jobs::iterator it = m_jobs.find(t);
+		if (it == m_jobs.end() || it->second.state != Job::QUEUED || it->second.priority != LOAD_NORMAL) return;
+		m_queue.erase(QueueEntry(it->second, t));
+		it->second.priority = LOAD_VISIBLE;
+		m_queue.insert(QueueEntry(it->second, t));
+	}
+	/// Upload completed images and generate deferred mipmaps, within the per frame budget (main thread only)
+	void apply() {
+		double budget = std::max(1.0, 1048576.0 * config["graphic/upload_budget"].f());
+		double used = 0.0;
+		// Mipmaps of textures uploaded on earlier frames
+		while (!m_mipmaps.empty() && used < budget) {
+			Mipmaps::value_type m = m_mipmaps.front();
+			m_mipmaps.pop_front();
+			UseTexture tex(*m.first);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4);
+			used += m.second;
+		}
+		std::vector<Job> done;
+		{
+			boost::mutex::scoped_lock l(m_mutex);
+			std::vector<void const*>::iterator it = m_done.begin();
+			for (; it != m_done.end() && used < budget; ++it) {
+				Jobs::iterator jt = m_jobs.find(*it);
+				if (jt == m_jobs.end() || jt->second.state != Job::DONE) continue;  // Removed or replaced
+				used += jt->second.bitmap.buf.size();
+				done.push_back(Job());
+				done.back().apply.swap(jt->second.apply);
+				done.back().bitmap.swap(jt->second.bitmap);
+				m_jobs.erase(jt);
+			}
+			m_done.erase(m_done.begin(), it);  // The rest waits for the next frame
+		}
+		// Load to OpenGL (targets are only destroyed in this thread, so they still exist)
+		Staging::Scope scope(staging);
+		for (std::vector<Job>::iterator it = done.begin(); it != done.end(); ++it) it->apply(it->bitmap);
+		if (!done.empty()) ++m_generation;
+	}
+	unsigned long generation() const { return m_generation; }
+	/// Generate the mipmaps of a texture on a later frame (main thread only)
+	void deferMipmaps(Texture* t, std::size_t bytes) {
+		for (Mipmaps::const_iterator it = m_mipmaps.begin(); it != m_mipmaps.end(); ++it) if (it->first == t) return;
+		m_mipmaps.push_back(std::make_pair(t, bytes));
+	}
+	/// Cancel deferred mipmaps (main thread only)
+	void removeMipmaps(Texture* t) {
+		for (Mipmaps::iterator it = m_mipmaps.begin(); it != m_mipmaps.end(); ++it) if (it->first == t) { m_mipmaps.erase(it); return; }
+	}
+
+  private:
+	/// Queue order: higher priority first, then in request order
+	struct QueueEntry {
+		LoadPriority priority;
+		unsigned long seq;
+		void const* target;
+		QueueEntry(Job const& j, void const* t): priority(j.priority), seq(j.seq), target(t) {}
+		bool operator<(QueueEntry const& e) const {
+			if (priority != e.priority) return priority > e.priority;
+			return seq < e.seq;
+		}
+	};
+	typedef std::map<void const*, Job> Jobs;
+
+	/// Remove a job (the lock must be held)
+	void erase(void const* t) {
+		Jobs::iterator it = m_jobs.find(t);
+		if (it == m_jobs.end()) return;
+		Job& j = it->second;
+		if (j.state == Job::QUEUED) m_queue.erase(QueueEntry(j, t));
+		if (j.state != Job::DONE) --m_pending;
+		Names::iterator nt = m_names.find(j.key());
+		if (nt != m_names.end()) {
+			nt->second.erase(t);
+			if (nt->second.empty()) m_names.erase(nt);
+		}
+		m_jobs.erase(it);
+	}
+
+	void run() {
+		while (true) {
+			std::string name;
+			fs::path filename;
+			unsigned thumbnail;
 			{
-				Job& j = it->second;
-				if (!j.name.empty()) { ++it; continue; }  // Job incomplete, skip it
-				j.apply(j.bitmap);  // Load to OpenGL
+				boost::mutex::scoped_lock l(m_mutex);
+				while (m_queue.empty() && !m_quit) m_condition.wait(l);
+				if (m_quit) return;
+				void const* target = m_queue.begin()->target;
+				m_queue.erase(m_queue.begin());
+				Job const& job = m_jobs[target];
+				name = job.key();
+				filename = job.name;
+				thumbnail = job.thumbnail;
+				// Every target waiting for this file gets the result of this decode
+				std::set<void const*> const& targets = m_names[name];
+				for (std::set<void const*>::const_iterator it = targets.begin(); it != targets.end(); ++it) {
+					Job& j = m_jobs[*it];
+					if (j.state != Job::QUEUED) continue;
+					m_queue.erase(QueueEntry(j, *it));
+					j.state = Job::LOADING;
+				}
+				m_loading.insert(name);
+			}
+			Bitmap bitmap;
+			boost::xtime start = now();
+			try {
+				if (thumbnail) loadThumbnail(bitmap, filename, thumbnail); else loadBitmap(bitmap, filename);
+				std::clog << "image/debug: Loaded " << name << " (" << bitmap.width << "x" << bitmap.height << ") in "
+				  << int(1e3 * (now() - start)) << " ms" << std::endl;
+			} catch (std::exception& e) {
+				std::clog << "image/error: " << e.what() << std::endl;
+			}
+			// Store the result (targets removed in the meantime are no longer in m_names)
+			boost::mutex::scoped_lock l(m_mutex);
+			m_loading.erase(name);
+			Names::iterator nt = m_names.find(name);
+			if (nt == m_names.end()) continue;
+			std::vector<Job*> jobs;
+			for (std::set<void const*>::const_iterator it = nt->second.begin(); it != nt->second.end(); ++it) {
+				Job& j = m_jobs[*it];
+				if (j.state != Job::LOADING) continue;
+				j.state = Job::DONE;
+				--m_pending;
+				m_done.push_back(*it);
+				jobs.push_back(&j);
+			}
+			for (std::size_t i = 0; i < jobs.size(); ++i) {
+				if (i + 1 < jobs.size()) jobs[i]->bitmap = bitmap; else jobs[i]->bitmap.swap(bitmap);
 			}
-			m_jobs.erase(it++);
 		}
 	}
+
+	typedef std::map<std::string, std::set<void const*> > Names;  ///< By job key
+	typedef std::deque<std::pair<Texture*, std::size_t> > Mipmaps;
+	volatile bool m_quit;
+	boost::thread_group m_threads;
+	boost::mutex m_mutex;
+	boost::condition m_condition;
+	Jobs m_jobs;
+	std::set<QueueEntry> m_queue; ///< Jobs waiting for a worker
+	Names m_names; ///< Targets of unfinished jobs by file name (job key)
+	std::set<std::string> m_loading; ///< Files being decoded (by job key)
+	std::vector<void const*> m_done; ///< Targets of completed jobs, for apply()
+	unsigned long m_seq;
+	volatile unsigned m_pending; ///< Jobs not yet completed
+	Mipmaps m_mipmaps; ///< Textures waiting for mipmaps, with their size in bytes
+	unsigned long m_generation; ///< Number of frames in which loaded images were applied
 } ldr;
 
 void updateSurfaces() { ldr.apply(); }
+unsigned long surfaceGeneration() { return ldr.generation(); }
 
-template <typename T> void loader(T* target, fs::path const& name) {
+template <typename T> void loader(T* target, fs::path const& name, LoadPriority priority, unsigned thumbnail = 0) {
 	// Temporarily add 1x1 pixel black texture
 	Bitmap bitmap;
 	bitmap.fmt = pix::RGB;
 	bitmap.resize(1, 1);
 	target->load(bitmap);
 	// Ask the loader to retrieve the image
-	ldr.push(target, Job(name, boost::bind(&T::load, target, _1)));
+	ldr.push(target, Job(name, thumbnail, boost::bind(&T::load, target, _1), priority));
 }
 
-Texture::Texture(std::string const& filename) { loader(this, filename); }
-Surface::Surface(std::string const& filename) { loader(this, filename); }
-Texture::~Texture() { ldr.remove(this); }
+Texture::Texture(std::string const& filename) { loader(this, filename, LOAD_NORMAL); }
+Surface::Surface(std::string const& filename, LoadPriority priority, unsigned thumbnail) { loader(this, filename, priority, thumbnail); }
+Texture::~Texture() { ldr.remove(this); ldr.removeMipmaps(this); }
 Surface::~Surface() { ldr.remove(this); }
 
 // Stuff for converting pix::Format into OpenGL enum values
@@ -155,6 +397,18 @@ namespace {
 		throw std::logic_error("Unknown pixel format");
 	}
 	GLint internalFormat() { return GL_EXT_framebuffer_sRGB ? GL_SRGB_ALPHA : GL_RGBA; }
+
+	/// Load a bitmap into the texture in use, through the staging buffers when called from Loader::apply
+	void texImage(GLenum type, Bitmap const& bitmap) {
+		PixFmt const& f = getPixFmt(bitmap.fmt);
+		glPixelStorei(GL_UNPACK_SWAP_BYTES, f.swap);
+		if (staging.active() && !bitmap.buf.empty() && staging.stage(bitmap)) {
+			glTexImage2D(type, 0, internalFormat(), bitmap.width, bitmap.height, 0, f.format, f.type, NULL);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);  // Other uploads use client memory
+			return;
+		}
+		glTexImage2D(type, 0, internalFormat(), bitmap.width, bitmap.height, 0, f.format, f.type, &bitmap.buf[0]);
+	}
 }
 
 void Texture::load(Bitmap const& bitmap) {
@@ -168,18 +422,34 @@ void Texture::load(Bitmap const& bitmap) {
 	// The texture wraps over at the edges (repeat)
 	glTexParameterf(type(), GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameterf(type(), GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameterf(type(), GL_TEXTURE_MAX_LEVEL, GLEW_VERSION_3_0 ? 4 : 0);  // Mipmaps currently b0rked on Intel, so disable them...
+	// Mipmaps are generated on a later frame (see Loader::apply), until then only the original is used
+	glTexParameterf(type(), GL_TEXTURE_MAX_LEVEL, 0);
 	glerror.check("glTexParameterf");
 
 	// Anisotropy is potential trouble maker
 	if (GLEW_EXT_texture_filter_anisotropic) glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 16.0f);
 	glerror.check("MAX_ANISOTROPY_EXT");
 
+	// Load the data into texture
+	texImage(type(), bitmap);
+	if (GLEW_VERSION_3_0) ldr.deferMipmaps(this, bitmap.buf.size());  // Mipmaps currently b0rked on Intel, so only with GL 3.0
+}
+
+void clearTexture(GLenum type, unsigned width, unsigned height) {
+	glutil::GLErrorChecker glerror("clearTexture");
+	glTexParameterf(type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameterf(type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameterf(type, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameterf(type, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	std::vector<unsigned char> zeros(width * height * 4);
+	glTexImage2D(type, 0, internalFormat(), width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &zeros[0]);
+}
+
+void loadTextureRegion(GLenum type, Bitmap const& bitmap, unsigned x, unsigned y) {
+	glutil::GLErrorChecker glerror("loadTextureRegion");
 	PixFmt const& f = getPixFmt(bitmap.fmt);
 	glPixelStorei(GL_UNPACK_SWAP_BYTES, f.swap);
-	// Load the data into texture
-	glTexImage2D(type(), 0, internalFormat(), bitmap.width, bitmap.height, 0, f.format, f.type, &bitmap.buf[0]);
-	glGenerateMipmap(type());
+	glTexSubImage2D(type, 0, x, y, bitmap.width, bitmap.height, f.format, f.type, &bitmap.buf[0]);
 }
 
 void Surface::load(Bitmap const& bitmap) {
@@ -189,12 +459,11 @@ void Surface::load(Bitmap const& bitmap) {
 	dimensions = Dimensions(bitmap.ar).fixedWidth(1.0f);
 	// Load the data into texture
 	UseTexture texture(m_texture);
-	PixFmt const& f = getPixFmt(bitmap.fmt);
-	glPixelStorei(GL_UNPACK_SWAP_BYTES, f.swap);
-	glTexImage2D(m_texture.type(), 0, internalFormat(), bitmap.width, bitmap.height, 0, f.format, f.type, &bitmap.buf[0]);
+	texImage(m_texture.type(), bitmap);
 }
 
 void Surface::draw() const {
+	ldr.touch(this);
 	if (!empty()) m_texture.draw(dimensions, TexCoords(tex.x1 * m_width, tex.y1 * m_height, tex.x2 * m_width, tex.y2 * m_height));
 }
 
@@ -103,6 +103,8 @@ struct TexCoords {
 
 /// This function hides the ugly global vari-- I mean singleton access to ScreenManager...
 Shader& getShader(std::string const& name);
+/// Same for the sprite batch of the window
+glutil::SpriteBatch& getSprites();
 
 /** @short A RAII wrapper for allocating/deallocating OpenGL texture ID **/
 template <GLenum Type> class OpenGLTexture: boost::noncopyable {
@@ -117,7 +119,7 @@ template <GLenum Type> class OpenGLTexture: boost::noncopyable {
 		throw std::logic_error("Unknown texture type");
 	}
 	OpenGLTexture(): m_id() { glGenTextures(1, &m_id); }
-	~OpenGLTexture() { glDeleteTextures(1, &m_id); }
+	~OpenGLTexture() { glutil::flushSprites(); glutil::forgetTexture(m_id); glDeleteTextures(1, &m_id); }
 	/// returns id
 	GLuint id() const { return m_id; };
 	/// draw in given dimensions, with given texture coordinates
@@ -133,23 +135,14 @@ class UseTexture: boost::noncopyable {
   public:
 	/// constructor
 	template <GLenum Type> UseTexture(OpenGLTexture<Type> const& tex):
-	  m_shader(/* hack of the year */ (glutil::GLErrorChecker("UseTexture"), glActiveTexture(GL_TEXTURE0), glBindTexture(Type, tex.id()), tex.shader())) {}
+	  m_shader(/* hack of the year */ (glutil::flushSprites(), glutil::bindTexture(Type, tex.id()), tex.shader())) {}
 
   private:
 	UseShader m_shader;
 };
 
 template <GLenum Type> void OpenGLTexture<Type>::draw(Dimensions const& dim, TexCoords const& tex) const {
-	glutil::VertexArray va;
-
-	UseTexture texture(*this);
-
-	va.TexCoord(tex.x1, tex.y1).Vertex(dim.x1(), dim.y1());
-	va.TexCoord(tex.x2, tex.y1).Vertex(dim.x2(), dim.y1());
-	va.TexCoord(tex.x1, tex.y2).Vertex(dim.x1(), dim.y2());
-	va.TexCoord(tex.x2, tex.y2).Vertex(dim.x2(), dim.y2());
-
-	va.Draw();
+	getSprites().add(shader(), Type, m_id, dim.x1(), dim.y1(), dim.x2(), dim.y2(), tex.x1, tex.y1, tex.x2, tex.y2);
 }
 
 template <GLenum Type> void OpenGLTexture<Type>::drawCropped(Dimensions const& orig, TexCoords const& tex) const {
@@ -164,6 +157,9 @@ template <GLenum Type> void OpenGLTexture<Type>::drawCropped(Dimensions const& o
 
 namespace pix { enum Format { INT_ARGB, CHAR_RGBA, RGB, BGR }; }
 
+/// Image loading order: visible images (drawn while still loading) first, background images last
+enum LoadPriority { LOAD_BACKGROUND, LOAD_NORMAL, LOAD_VISIBLE };
+
 struct Bitmap {
 	std::vector<unsigned char> buf;
 	unsigned width, height;
@@ -186,6 +182,13 @@ struct Bitmap {
 };
 
 void updateSurfaces();
+/// Changes whenever updateSurfaces loads new images (for caching anything drawn from them)
+unsigned long surfaceGeneration();
+
+/// Allocate a transparent texture without mipmaps, to be filled with loadTextureRegion (the texture must be in use, see UseTexture)
+void clearTexture(GLenum type, unsigned width, unsigned height);
+/// Load a bitmap into a part of a texture (the texture must be in use)
+void loadTextureRegion(GLenum type, Bitmap const& bitmap, unsigned x, unsigned y);
 
 /**
 * @short Texture wrapper.
@@ -218,10 +221,11 @@ class Surface {
 	/// texture coordinates
 	TexCoords tex;
 	Surface(): m_width(0), m_height(0) {}
-	/// creates surface from file
-	Surface(std::string const& filename);
+	/// creates surface from file (loaded in the background), optionally downscaled to fit in thumbnail x thumbnail pixels
+	Surface(std::string const& filename, LoadPriority priority = LOAD_NORMAL, unsigned thumbnail = 0);
 	~Surface();
 	bool empty() const { return m_width * m_height == 0; } ///< Test if the loading has failed
+	std::size_t bytes() const { return 4 * m_width * m_height; } ///< Approximate texture memory used
 	/// draws surface
 	void draw() const;
 	/// loads surface into buffer
@@ -232,3 +236,10 @@ class Surface {
 	OpenGLTexture<GL_TEXTURE_RECTANGLE> m_texture;
 };
 
+/// A cover image, loaded as a thumbnail (cached on disk) instead of at full resolution
+class Thumbnail: public Surface {
+  public:
+	static const unsigned SIZE = 512; ///< Enough for covers drawn at up to a quarter of a Full HD screen
+	Thumbnail(std::string const& filename): Surface(filename, LOAD_NORMAL, SIZE) {}
+};
+
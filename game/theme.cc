@@ -65,5 +65,5 @@ ThemeInstrumentMenu::ThemeInstrumentMenu():
 
 SvgTxtTheme& ThemeInstrumentMenu::getCachedOption(const std::string& text) {
 	if (options.contains(text)) return options[text];
-	return *options.insert(text, new SvgTxtTheme(getThemePath("instrumentmenu_option.svg"), config["graphic/text_lod"].f()))->second;
+	return options.insert(text, new SvgTxtTheme(getThemePath("instrumentmenu_option.svg"), config["graphic/text_lod"].f()));
 }
@@ -1,9 +1,11 @@
 #include "unicode.hh"
 #include "configuration.hh"
 
+#include <boost/cstdint.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <glibmm/ustring.h>
 #include <glib.h>
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 
@@ -28,10 +30,39 @@ namespace {
 	}
 }
 
+bool isUTF8(char const* begin, char const* end) {
+	unsigned char const* p = reinterpret_cast<unsigned char const*>(begin);
+	unsigned char const* e = reinterpret_cast<unsigned char const*>(end);
+	while (p != e) {
+		// Skip ASCII eight bytes at a time
+		while (e - p >= 8) {
+			boost::uint64_t word;
+			std::memcpy(&word, p, 8);
+			if (word & 0x8080808080808080ULL) break;
+			p += 8;
+		}
+		if (p == e) break;
+		unsigned char ch = *p;
+		if (ch < 0x80) { ++p; continue; }
+		// Multi-byte sequence: check the length, continuation bytes, overlong forms and surrogates
+		unsigned len;
+		unsigned char lo = 0x80, hi = 0xBF;  // Valid range of the second byte
+		if (ch >= 0xC2 && ch <= 0xDF) len = 2;
+		else if (ch >= 0xE0 && ch <= 0xEF) { len = 3; if (ch == 0xE0) lo = 0xA0; else if (ch == 0xED) hi = 0x9F; }
+		else if (ch >= 0xF0 && ch <= 0xF4) { len = 4; if (ch == 0xF0) lo = 0x90; else if (ch == 0xF4) hi = 0x8F; }
+		else return false;
+		if (unsigned(e - p) < len) return false;
+		if (p[1] < lo || p[1] > hi) return false;
+		for (unsigned i = 2; i < len; ++i) if ((p[i] & 0xC0) != 0x80) return false;
+		p += len;
+	}
+	return true;
+}
+
 void convertToUTF8(std::stringstream &_stream, std::string _filename) {
 	try {
 		std::string data = _stream.str();
-		convert(data, "UTF-8", "UTF-8"); // Test if input is UTF-8
+		if (!isUTF8(data.data(), data.data() + data.size())) throw std::runtime_error("Not UTF-8");
 		if (data.substr(0, 3) == "\xEF\xBB\xBF") {
 			std::clog << "unicode/warning: " << _filename << " UTF-8 BOM ignored. Please avoid editors that use BOMs (e.g. Notepad)." << std::endl;
 			_stream.str(data.substr(3)); // Remove BOM if there is one
@@ -68,3 +99,25 @@ std::string unicodeCollate(std::string const& str) {
 	return ustr2;
 	// Should use ustr2.casefold_collate_key() instead of tolower, but it seems to be crashing...
 }
+
+std::string unicodeSearchKey(std::string const& str) {
+	// Decompose so that accents become separate combining marks, then drop the marks
+	char* nfd = g_utf8_normalize(str.data(), str.size(), G_NORMALIZE_NFKD);
+	if (!nfd) {
+		// Not valid UTF-8, just lower case ASCII
+		std::string ret = str;
+		for (std::string::iterator it = ret.begin(); it != ret.end(); ++it) if (*it >= 'A' && *it <= 'Z') *it += 'a' - 'A';
+		return ret;
+	}
+	std::string stripped;
+	stripped.reserve(str.size());
+	for (char const* p = nfd; *p; p = g_utf8_next_char(p)) {
+		if (g_unichar_type(g_utf8_get_char(p)) == G_UNICODE_NON_SPACING_MARK) continue;
+		stripped.append(p, g_utf8_next_char(p));
+	}
+	g_free(nfd);
+	char* folded = g_utf8_casefold(stripped.data(), stripped.size());
+	std::string ret(folded);
+	g_free(folded);
+	return ret;
+}
@@ -3,6 +3,10 @@
 #include <iostream>
 #include <string>
 
+/** Check if a range of bytes is valid UTF-8 (fast path for plain ASCII) **/
+bool isUTF8(char const* begin, char const* end);
 void convertToUTF8(std::stringstream &_stream, std::string _filename = std::string());
 std::string convertToUTF8(std::string const& str);
 std::string unicodeCollate(std::string const& str);
+/** Convert a string to the form used for searching (case folded, accents removed) **/
+std::string unicodeSearchKey(std::string const& str);
@@ -151,43 +151,45 @@ Window::Window(unsigned int width, unsigned int height, bool fs): m_windowW(widt
 Window::~Window() { }
 
 void Window::blank() {
+	m_sprites.flush();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void Window::updateStereo(float sepFactor) {
+	m_sprites.flush();
 	for (ShaderMap::iterator it = m_shaders.begin(); it != m_shaders.end(); ++it) {
 		Shader& sh = *it->second;
 		sh.bind();
-		try {
-			sh["sepFactor"].set(sepFactor);
-			sh["z0"].set(z0 - 2.0f * near_);  // Why minus two times zNear, I have no idea -Tronic
-		} catch(...) {}  // Not fatal if 3d shader is missing
+		// No-ops if the 3d shader is missing
+		sh.sepFactor.set(sepFactor);
+		sh.z0.set(z0 - 2.0f * near_);  // Why minus two times zNear, I have no idea -Tronic
 	}
 }
 
 void Window::updateColor() {
+	m_sprites.color(g_color);
 	for (ShaderMap::iterator it = m_shaders.begin(); it != m_shaders.end(); ++it) {
 		Shader& sh = *it->second;
-		sh["colorMatrix"].setMat4(g_color);
+		sh.bind().colorMatrix.setMat4(g_color);
 	}
 }
 
 void Window::updateTransforms() {
 	using namespace glmath;
 	mat3 normal(g_modelview);
+	m_sprites.transforms(g_projection, g_modelview);
 	for (ShaderMap::iterator it = m_shaders.begin(); it != m_shaders.end(); ++it) {
 		Shader& sh = *it->second;
 		sh.bind();
-		sh["projMatrix"].setMat4(g_projection);
-		sh["mvMatrix"].setMat4(g_modelview);
-		try {
-			sh["normalMatrix"].setMat3(normal);
-		} catch(...) {}  // Not fatal if normalMatrix is missing (only 3d objects use it)
+		sh.projMatrix.setMat4(g_projection);
+		sh.mvMatrix.setMat4(g_modelview);
+		sh.normalMatrix.setMat3(normal);  // Only 3d objects use it, a no-op for others
 	}
 }
 
 void Window::render(boost::function<void (void)> drawFunc) {
 	glutil::GLErrorChecker glerror("Window::render");
+	m_sprites.flush();
 	ViewTrans trans;  // Default frustum
 	if (s_width < screen->w || s_height < screen->h) glClear(GL_COLOR_BUFFER_BIT);  // Black bars
 	bool stereo = config["graphic/stereo3d"].b();
@@ -196,11 +198,11 @@ void Window::render(boost::function<void (void)> drawFunc) {
 	// Over/under only available in fullscreen
 	if (stereo && type == 2 && !m_fullscreen) stereo = false;
 
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glutil::blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 	updateStereo(stereo ? getSeparation() : 0.0);
 	glerror.check("setup");
 	// Can we do direct to framebuffer rendering (no FBO)?
-	if (!stereo || type == 2) { view(stereo); drawFunc(); return; }
+	if (!stereo || type == 2) { view(stereo); drawFunc(); m_sprites.flush(); return; }
 	// Render both eyes to FBO (full resolution top/bottom for anaglyph)
 	unsigned w = s_width;
 	unsigned h = 2 * s_height;
@@ -217,7 +219,7 @@ void Window::render(boost::function<void (void)> drawFunc) {
 	// Render to actual framebuffer from FBOs
 	UseTexture use(fbo.getTexture());
 	view(0);  // Viewport for drawable area
-	glDisable(GL_BLEND);
+	glutil::blend(false);
 	glmath::mat4 colorMatrix = glmath::mat4::identity();
 	updateStereo(0.0);  // Disable stereo mode while we composite
 	glerror.check("FBO->FB setup");
@@ -245,24 +247,27 @@ void Window::render(boost::function<void (void)> drawFunc) {
 		dim.center((num == 0 ? 0.25 : -0.25) * dim.h());
 		if (num == 1) {
 			// Right eye blends over the left eye
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_ONE, GL_ONE);
+			m_sprites.flush();
+			glutil::blend(true);
+			glutil::blendFunc(GL_ONE, GL_ONE);
 		}
 		fbo.getTexture().draw(dim, TexCoords(0.0, h, w, 0));
 	}
+	m_sprites.flush();
 	glerror.check("FBO->FB postcondition");
 }
 
 void Window::view(unsigned num) {
 	glutil::GLErrorChecker glerror("Window::view");
+	m_sprites.flush();
 	// Set flags
 	glClearColor (0.0f, 0.0f, 0.0f, 1.0f);
 	glDisable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glutil::blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
 	glShadeModel(GL_SMOOTH);
-	glEnable(GL_BLEND);
+	glutil::blend(true);
 	if (GL_EXT_framebuffer_sRGB) glEnable(GL_FRAMEBUFFER_SRGB);
 	shader("color").bind();
 	// Setup views (with black bars for cropping)
@@ -292,6 +297,7 @@ void Window::view(unsigned num) {
 }
 
 void Window::swap() {
+	m_sprites.flush();
 	SDL_GL_SwapBuffers();
 }
 
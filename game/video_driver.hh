@@ -3,6 +3,7 @@
 #include "glmath.hh"
 #include "glshader.hh"
 #include "glutil.hh"
+#include "spritebatch.hh"
 #include <boost/function.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
 
@@ -81,6 +82,8 @@ public:
 		// const_cast required to workaround ptr_map's protection against construction of temporaries
 		return *m_shaders.insert(const_cast<std::string&>(name), new Shader(name)).first->second;
 	}
+	/// Batch for drawing textured quads
+	glutil::SpriteBatch& sprites() { return m_sprites; }
 	void updateColor();
 	void updateTransforms();
 private:
@@ -94,5 +97,6 @@ private:
 	bool m_fullscreen;
 	typedef boost::ptr_map<std::string, Shader> ShaderMap;
 	ShaderMap m_shaders; ///< Shader programs by name
+	glutil::SpriteBatch m_sprites;
 };
 
@@ -0,0 +1,109 @@
+#include "wavfile.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	boost::uint32_t le32(char const* p) {
+		unsigned char const* u = reinterpret_cast<unsigned char const*>(p);
+		return u[0] | u[1] << 8 | u[2] << 16 | boost::uint32_t(u[3]) << 24;
+	}
+	boost::uint16_t le16(char const* p) {
+		unsigned char const* u = reinterpret_cast<unsigned char const*>(p);
+		return u[0] | u[1] << 8;
+	}
+	const unsigned WAVE_FORMAT_PCM = 0x0001;
+	const unsigned WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+	const unsigned WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+	const size_t PREFETCH_FRAMES = 48000;  // About a second of audio is paged in ahead of playback
+}
+
+WavFile::WavFile(std::string const& filename, unsigned int rate):
+  m_data(), m_frames(), m_rate(rate), m_channels(), m_bytes(), m_frameSize(), m_format(INT)
+{
+	// Check the magic before mapping anything (most songs are not WAV)
+	{
+		char magic[12] = {};
+		std::FILE* f = std::fopen(filename.c_str(), "rb");
+		if (!f) throw unsupported("Cannot open " + filename);
+		size_t got = std::fread(magic, 1, sizeof(magic), f);
+		std::fclose(f);
+		if (got != sizeof(magic) || std::memcmp(magic, "RIFF", 4) || std::memcmp(magic + 8, "WAVE", 4)) throw unsupported("Not a RIFF/WAVE file");
+	}
+	try { m_file.open(filename); } catch (std::runtime_error& e) { throw unsupported(e.what()); }
+	char const* ptr = m_file.begin() + 12;
+	char const* end = m_file.end();
+	bool fmt = false;
+	// Walk the chunks; fmt must precede data
+	while (end - ptr >= 8) {
+		boost::uint32_t size = le32(ptr + 4);
+		char const* chunk = ptr + 8;
+		if (!std::memcmp(ptr, "fmt ", 4)) {
+			if (size < 16 || end - chunk < 16) throw unsupported("Truncated fmt chunk");
+			unsigned tag = le16(chunk);
+			m_channels = le16(chunk + 2);
+			unsigned srate = le32(chunk + 4);
+			unsigned bits = le16(chunk + 14);
+			if (tag == WAVE_FORMAT_EXTENSIBLE && size >= 40 && end - chunk >= 40) tag = le16(chunk + 24);  // SubFormat GUID
+			if (tag == WAVE_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) m_format = INT;
+			else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32) m_format = FLOAT;
+			else throw unsupported("Compressed or unknown sample format");
+			if (m_channels != 1 && m_channels != 2) throw unsupported("Only mono and stereo are supported");
+			if (srate != m_rate) throw unsupported("Sample rate differs from the mixing rate");
+			m_bytes = bits / 8;
+			m_frameSize = m_bytes * m_channels;
+			fmt = true;
+		} else if (!std::memcmp(ptr, "data", 4)) {
+			if (!fmt) throw unsupported("data chunk before fmt");
+			m_data = chunk;
+			// Writers that stream often leave the size unset (0 or 0xFFFFFFFF), so clamp it to the file
+			size_t avail = end - chunk;
+			m_frames = std::min<size_t>(size ? size : avail, avail) / m_frameSize;
+			return;
+		}
+		if (size_t(end - chunk) < size) break;
+		ptr = chunk + size + (size & 1);  // Chunks are padded to even size
+	}
+	throw unsupported("No audio data found");
+}
+
+float WavFile::sample(char const* p) const {
+	if (m_format == FLOAT) {
+		boost::uint32_t bits = le32(p);
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+	switch (m_bytes) {
+	  case 1: return (static_cast<unsigned char>(*p) - 128) * (1.0f / 128.0f);
+	  case 2: return boost::int16_t(le16(p)) * (1.0f / 32768.0f);
+	  case 3: {
+		unsigned char const* u = reinterpret_cast<unsigned char const*>(p);
+		return boost::int32_t(u[0] << 8 | u[1] << 16 | boost::uint32_t(u[2]) << 24) * (1.0f / 2147483648.0f);
+	  }
+	  default: return boost::int32_t(le32(p)) * (1.0f / 2147483648.0f);
+	}
+}
+
+bool WavFile::operator()(float* begin, float* end, boost::int64_t pos, float volume) const {
+	for (float* it = begin; it != end; ++it, ++pos) {
+		if (pos < 0) continue;
+		boost::int64_t frame = pos / 2;
+		if (frame >= m_frames) break;
+		unsigned ch = m_channels == 1 ? 0 : pos % 2;
+		*it += volume * sample(m_data + frame * m_frameSize + ch * m_bytes);
+	}
+	return pos / 2 < m_frames;
+}
+
+bool WavFile::prepare(boost::int64_t pos) const {
+	boost::int64_t frame = std::max<boost::int64_t>(0, pos / 2);
+	if (frame >= m_frames) return true;
+	char const* b = m_data + frame * m_frameSize;
+	char const* e = m_data + std::min<boost::int64_t>(m_frames, frame + PREFETCH_FRAMES) * m_frameSize;
+	volatile char sink = 0;
+	for (char const* p = b; p < e; p += 4096) sink = sink + *p;
+	return true;
+}
+
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "mappedfile.hh"
+#include <boost/cstdint.hpp>
+#include <stdexcept>
+#include <string>
+
+/**
+* @short Threadless decoder for uncompressed RIFF/WAVE files.
+* The file is memory-mapped and PCM is converted on the fly in the audio callback.
+* Only files already at the mixing rate are handled; the constructor throws
+* WavFile::unsupported for anything else so that the caller can fall back to FFmpeg.
+**/
+class WavFile {
+  public:
+	struct unsupported: public std::runtime_error {
+		unsupported(std::string const& msg): std::runtime_error(msg) {}
+	};
+	/// Open a file for playback at the given rate (frames per second)
+	WavFile(std::string const& filename, unsigned int rate);
+	/// Mix stereo samples starting at interleaved sample position pos, returns false at EOF
+	bool operator()(float* begin, float* end, boost::int64_t pos, float volume = 1.0f) const;
+	/// Page in the data following pos so that the audio callback doesn't stall on it (always ready)
+	bool prepare(boost::int64_t pos) const;
+	/// Duration in seconds
+	double duration() const { return double(m_frames) / m_rate; }
+  private:
+	enum Format { INT, FLOAT };
+	float sample(char const* ptr) const;
+	MappedFile m_file;
+	char const* m_data; ///< Beginning of PCM data within the mapping
+	boost::int64_t m_frames; ///< Number of sample frames
+	unsigned int m_rate;
+	unsigned int m_channels;
+	unsigned int m_bytes; ///< Bytes per sample (single channel)
+	unsigned int m_frameSize; ///< Bytes per frame (all channels)
+	Format m_format;
+};
+